@@ -11,15 +11,16 @@ public:
 	Application();
 	~Application();
 
-	void init();
+	// False when no window with an OpenGL 4.5 core context could be created
+	bool init();
 	void run();
 	void shutdown();
 
 private:
 
 	std::unique_ptr<Renderer> renderer;
-	World* world;
-	Player* player;
+	World* world = nullptr;
+	Player* player = nullptr;
 
 	float deltaTime = 0.0f; // Time between current frame and last frame	
 	double lastTime = 0.0f;
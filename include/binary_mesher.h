@@ -0,0 +1,30 @@
+#pragma once
+
+#include "chunk.h"
+#include "chunk_snapshot.h"
+#include <cstdint>
+
+// Greedy mesher working on the 64-bit column masks of a chunk snapshot.
+// Face visibility and AO occupancy are computed for a whole column at once with shifts,
+// visible cells are found with countr_zero and quads are merged on bit rows. It produces
+// the same quads as Chunk::processDirection, only faster.
+class BinaryMesher {
+
+public:
+	void generate(const ChunkSnapshot& snapshot, MeshData& opaque, MeshData& transparent);
+
+private:
+	static const int SIZE = Chunk::CHUNK_SIZE;
+	static const int HEIGHT = Chunk::CHUNK_HEIGHT;
+
+	// Visible faces for the current direction, one mask per column
+	uint64_t m_visible[SIZE][SIZE];
+
+	// Unvisited visible cells of every slice along the face normal, one bit row per [slice][u]
+	uint64_t m_rows[HEIGHT][HEIGHT];
+
+	// Merge key (block type and AO levels) of each visible cell, indexed [x][y][z]
+	uint16_t m_keys[SIZE][HEIGHT][SIZE];
+
+	void processDirection(const ChunkSnapshot& snapshot, int face, MeshData& opaque, MeshData& transparent);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cube.h"
+#include <vector>
+#include <array>
+#include <cstdint>
+
+// Palette-compressed block storage.
+// Every cell stores an index into a small palette of block types. Indices are bit-packed
+// into 64-bit words with 1, 2, 4 or 8 bits per cell, so an entry never straddles two words
+// and a read is a shift and a mask without any branch.
+// A storage holding a single block type keeps no indices at all (0 bits per cell).
+class BlockStorage {
+
+public:
+	static_assert(Atlas::TYPE_COUNT <= 256, "BlockStorage palette indices are at most 8 bits");
+
+	explicit BlockStorage(size_t size, BlockType fillType = BlockType::None);
+
+	inline BlockType get(size_t index) const {
+		uint64_t word = m_data[index >> m_wordShift];
+		uint64_t shift = (index & m_slotMask) << m_bitsShift;
+		return m_palette[(word >> shift) & m_valueMask];
+	}
+
+	void set(size_t index, BlockType type);
+
+	// Reset every cell to a single type, shrinking the storage back to its smallest size
+	void fill(BlockType type);
+
+	// True when every cell holds the same block type
+	bool isUniform() const { return m_distinctTypes == 1; }
+	BlockType getUniformType() const { return m_palette[0]; }
+
+	size_t getCount(BlockType type) const { return m_typeCounts[size_t(type)]; }
+
+	size_t getSize() const { return m_size; }
+	int getBitsPerEntry() const { return m_valueMask == 0 ? 0 : 1 << m_bitsShift; }
+	const std::vector<BlockType>& getPalette() const { return m_palette; }
+
+	// Heap bytes used by the palette and the packed indices
+	size_t getMemoryUsage() const;
+
+private:
+	static constexpr uint8_t NO_INDEX = 0xFF;
+
+	size_t m_size;
+
+	uint64_t m_bitsShift;  // log2 of bits per entry
+	uint64_t m_wordShift;  // log2 of entries per word
+	uint64_t m_slotMask;   // entries per word - 1
+	uint64_t m_valueMask;  // (1 << bits per entry) - 1
+
+	std::vector<BlockType> m_palette;
+	std::array<uint8_t, Atlas::TYPE_COUNT> m_paletteIndex; // BlockType -> palette index
+	std::vector<uint64_t> m_data;
+
+	std::array<uint32_t, Atlas::TYPE_COUNT> m_typeCounts; // cells per block type
+	int m_distinctTypes;
+
+	void resize(uint64_t bitsPerEntry);
+	uint8_t addToPalette(BlockType type);
+};
@@ -2,8 +2,13 @@
 
 #include "cube.h"
 #include "mesh.h"
+#include "chunk_mesh.h"
+#include "block_storage.h"
 #include <vector>
+#include <array>
 #include <unordered_set>
+#include <cstdint>
+#include <bit>
 
 
 namespace std {
@@ -22,16 +27,52 @@ namespace std {
 	};
 }
 
-const float m_aoValues[4] = { 0.2f, 0.35f, 0.5f, 0.8f };
+constexpr float m_aoValues[4] = { 0.2f, 0.35f, 0.5f, 0.8f };
 
-// Neighbor Indices
-const glm::ivec3 m_neighborFaceIndices[4] = {
+// Neighbor Indices (side, corner, side) of each face vertex, into m_faceAos
+constexpr int m_neighborFaceIndices[4][3] = {
 	{7, 6, 5},
 	{5, 4, 3},
 	{1, 0, 7},
 	{3, 2, 1},
 };
 
+// AO levels of the 4 face vertices (2 bits each, indexing m_aoValues) for every occupancy byte,
+// where bit k is set when the neighbor m_faceAos[face][k] is solid
+constexpr std::array<uint8_t, 256> makeAoLevelTable() {
+	std::array<uint8_t, 256> table{};
+	for (int occupancy = 0; occupancy < 256; ++occupancy) {
+		int levels = 0;
+		for (int v = 0; v < 4; ++v) {
+			int s1 = (occupancy >> m_neighborFaceIndices[v][0]) & 1;
+			int c = (occupancy >> m_neighborFaceIndices[v][1]) & 1;
+			int s2 = (occupancy >> m_neighborFaceIndices[v][2]) & 1;
+			int state = (s1 + s2 == 2) ? 0 : 3 - (s1 + s2 + c);
+			levels |= state << (2 * v);
+		}
+		table[occupancy] = uint8_t(levels);
+	}
+	return table;
+}
+
+// Whether a quad with these AO levels is split along its other diagonal, so the darker corners are not interpolated across
+constexpr std::array<bool, 256> makeAoFlipTable() {
+	std::array<bool, 256> table{};
+	for (int levels = 0; levels < 256; ++levels) {
+		float diagA = m_aoValues[levels & 3] + m_aoValues[(levels >> 6) & 3];
+		float diagB = m_aoValues[(levels >> 2) & 3] + m_aoValues[(levels >> 4) & 3];
+		table[levels] = diagA > diagB;
+	}
+	return table;
+}
+
+constexpr std::array<uint8_t, 256> m_aoLevelTable = makeAoLevelTable();
+constexpr std::array<bool, 256> m_aoFlipTable = makeAoFlipTable();
+
+inline float aoValue(uint8_t levels, int corner) {
+	return m_aoValues[(levels >> (2 * corner)) & 3];
+}
+
 // Neighbor Positions
 const std::vector<std::vector<glm::ivec3>> m_faceAos = {
     // Left face (-X)
@@ -104,27 +145,34 @@ const std::vector<std::vector<glm::ivec3>> m_faceAos = {
 
 
 class World;
+struct ChunkSnapshot;
+struct MeshScratch;
+struct MeshData;
 
 class Chunk {
 
+	friend class BinaryMesher;
+	friend struct ChunkSnapshot;
+	friend class TerrainGenerator;
 
 public:
 	static const int CHUNK_SIZE = 48;
 	static const int CHUNK_HEIGHT = 64;
 	static const int WATER_HEIGHT = 15; 
+	static const int SECTION_HEIGHT = 16;
+	static const int SECTION_COUNT = CHUNK_HEIGHT / SECTION_HEIGHT;
+	static const uint8_t ALL_SECTIONS = (1 << SECTION_COUNT) - 1;
+	static_assert(SECTION_COUNT == ChunkMesh::SECTION_COUNT, "chunk meshes keep one slot per section");
 
 	Chunk(int x = 0, int y = 0, int z = 0, World* world = nullptr);
 	Chunk(const Chunk* chunk);
 	~Chunk();
 
-	BlockType cubes[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE];
-
-	Mesh* getMesh() { return m_mesh.get(); }
-	Mesh* getTransparentMesh() { return m_transparentMesh.get(); }
+	ChunkMesh* getMesh() { return m_mesh.get(); }
+	ChunkMesh* getTransparentMesh() { return m_transparentMesh.get(); }
 
 	glm::vec3 getWorldPosition() const { return glm::vec3(m_x, m_y, m_z); }
 	glm::ivec3 getPositionGrid() const { return glm::ivec3(m_x / CHUNK_SIZE, m_y / CHUNK_HEIGHT, m_z / CHUNK_SIZE); }
-	int getIndexCount() { return m_indexCount; }
 
 	void setBlockType(int x, int y, int z, BlockType type);
 
@@ -133,61 +181,157 @@ public:
 	BlockType getBlockTypeWorldPos(int worldX, int worldY, int worldZ) const;
 	BlockType getBlockTypeWorldPos(glm::ivec3 worldPos) const;
 
-	// Load chunk data from noise function
-	void load();
+	// Bytes used by the palette-compressed block data
+	size_t getBlockMemoryUsage() const;
+
+	// Per-column occupancy masks, bit y is set when the cell at height y is of that kind.
+	// Transparent covers water and leaves; solid is everything but air and water.
+	uint64_t getOpaqueColumn(int x, int z) const { return m_opaqueMask[x][z]; }
+	uint64_t getTransparentColumn(int x, int z) const { return m_transparentMask[x][z]; }
+	uint64_t getWaterColumn(int x, int z) const { return m_waterMask[x][z]; }
+	uint64_t getSolidColumn(int x, int z) const { return m_opaqueMask[x][z] | (m_transparentMask[x][z] & ~m_waterMask[x][z]); }
+	uint64_t getFilledColumn(int x, int z) const { return m_opaqueMask[x][z] | m_transparentMask[x][z]; }
+
+	bool isSolid(int x, int y, int z) const { return (getSolidColumn(x, z) >> y) & 1; }
+
+	// Height of the topmost non-air cell + 1, 0 for an empty column
+	int getColumnHeight(int x, int z) const { return CHUNK_HEIGHT - std::countl_zero(getFilledColumn(x, z)); }
+
+	// Sections are 16-high slices of the chunk, uniform ones (all air, all stone...) store no per-cell data
+	bool isSectionUniform(int section) const { return m_sections[section].isUniform(); }
+	bool isSectionEmpty(int section) const {
+		return m_sections[section].isUniform() && m_sections[section].getUniformType() == BlockType::None;
+	}
+
 
+	// Generate mesh data from a snapshot of the chunk and its border using greedy meshing
+	// (binary or per-cell, see World::useBinaryMesher) into the empty opaque and transparent payloads.
+	// Only the sections in snapshot.sectionMask are meshed. Safe to run on a worker thread with that
+	// worker's scratch memory, it touches no chunk state.
+	void generateMeshData(const ChunkSnapshot& snapshot, MeshScratch& scratch, MeshData& opaque, MeshData& transparent) const;
 
-	// Generate mesh data for the chunk using greedy meshing
-	void generateMeshData();
+	// Upload generated payloads, patching the current meshes when only some sections were remeshed.
+	// Without keepCpuData the meshes are GPU-resident and keep no vertices. Nothing is copied on the
+	// CPU; the payloads come back holding the buffers to recycle.
+	void uploadMesh(std::unique_ptr<MeshData>& opaque, std::unique_ptr<MeshData>& transparent, bool keepCpuData);
 
-    void swapMeshes();
+	// Bytes held by the meshes on the CPU and in vertex buffers
+	size_t getMeshCpuMemoryUsage() const;
+	size_t getMeshGpuMemoryUsage() const;
 
-	inline bool isBlockFaceVisible(int x, int y, int z, const glm::ivec3& dir, BlockType faceType) const;
+	// Sections needing a remesh (bit s for section s), accumulated until the next mesh job
+	void markDirty(uint8_t sectionMask) { m_dirtySections |= sectionMask; }
+	// Sections the next mesh job has to rebuild: all of them until the chunk has a mesh
+	uint8_t takeDirtySections();
 
-	inline bool isTransparentBlock(BlockType type) const {
+	static inline bool isTransparentBlock(BlockType type) {
 		return type == BlockType::Water || type == BlockType::Leaves;
 	}
 
-	void draw() const;
-	void drawTransparent() const;
+	// Whether a face of faceType is drawn when neighborType sits in front of it
+	static inline bool isFaceVisibleAgainst(BlockType faceType, BlockType neighborType) {
+		if (faceType == BlockType::None) return false;
+		if (faceType == BlockType::Water) return neighborType == BlockType::None;
+		return neighborType == BlockType::None || isTransparentBlock(neighborType);
+	}
+
+	// World-space box around the occupied cells, tightened to the lowest and highest non-air
+	// block when the mesh is uploaded. Empty before the first upload or for an empty chunk.
+	glm::vec3 getBoundsMin() const { return glm::vec3(m_x, m_y + m_minHeight, m_z); }
+	glm::vec3 getBoundsMax() const { return glm::vec3(m_x + CHUNK_SIZE, m_y + m_maxHeight, m_z + CHUNK_SIZE); }
+	bool isEmpty() const { return m_maxHeight <= m_minHeight; }
+
+	// Occluder volume for software occlusion culling: the chunk is split into OCCLUDER_TILES x OCCLUDER_TILES
+	// tiles of columns, each fully opaque from y = 0 up to its height. Updated with the bounds.
+	static const int OCCLUDER_TILES = 4;
+	static const int OCCLUDER_TILE_SIZE = CHUNK_SIZE / OCCLUDER_TILES;
+	int getOccluderHeight(int tileX, int tileZ) const { return m_occluderHeights[tileX][tileZ]; }
+
+	// Which pairs of faces see each other through non-opaque cells, one bit per pair (see VisibilityGraph).
+	// Every pair is connected until the first mesh job computes it.
+	uint16_t getFaceConnectivity() const { return m_faceConnectivity; }
+	void setFaceConnectivity(uint16_t connectivity) { m_faceConnectivity = connectivity; }
+
+	// Face directions that can face eye from somewhere inside the chunk, bit i for face index i
+	uint8_t getVisibleFaces(const glm::vec3& eye) const;
+
+	// Draw the faces in faceMask at the chunk origin, return the number of quads drawn
+	size_t draw(uint8_t faceMask = ChunkMesh::ALL_FACES) const;
+	size_t drawTransparent(uint8_t faceMask = ChunkMesh::ALL_FACES) const;
+
+	// Append the same draws as indirect commands whose chunk origin is read at baseInstance
+	size_t appendDrawCommands(uint8_t faceMask, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) const;
+	size_t appendTransparentDrawCommands(uint8_t faceMask, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) const;
+
+	// Quads in the active opaque and transparent meshes
+	size_t getQuadCount() const;
 
-	std::array<float, 4> getAmbientOcclusion(const glm::ivec3& pos, const glm::ivec3& dir) const;
+	// AO levels of a face (see m_aoLevelTable)
+	static uint8_t getAmbientOcclusion(const ChunkSnapshot& snapshot, const glm::ivec3& pos, const glm::ivec3& dir);
 
 
 private:
 
 	int m_x, m_y, m_z;
-	int m_indexCount;
 
-	bool m_visited[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE];
-    std::array<float, 4> m_aoCache[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE];
-	bool m_visibilityCache[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE];
+	// Block ids, one palette-compressed storage per section, each indexed as [x][y][z]
+	std::vector<BlockStorage> m_sections;
 
-    std::array<float, 4> nextAo;
+	static inline size_t sectionIndex(int x, int y, int z) {
+		return (size_t(x) * SECTION_HEIGHT + (y % SECTION_HEIGHT)) * CHUNK_SIZE + z;
+	}
+
+	// Unchecked access for positions known to be inside the chunk
+	inline BlockType getBlock(int x, int y, int z) const {
+		return m_sections[y / SECTION_HEIGHT].get(sectionIndex(x, y, z));
+	}
+
+	inline void setBlock(int x, int y, int z, BlockType type) {
+		m_sections[y / SECTION_HEIGHT].set(sectionIndex(x, y, z), type);
+
+		uint64_t bit = uint64_t(1) << y;
+		m_opaqueMask[x][z] &= ~bit;
+		m_transparentMask[x][z] &= ~bit;
+		m_waterMask[x][z] &= ~bit;
+		if (type == BlockType::None) return;
+		if (type == BlockType::Water) m_waterMask[x][z] |= bit;
+		if (isTransparentBlock(type)) m_transparentMask[x][z] |= bit;
+		else m_opaqueMask[x][z] |= bit;
+	}
+
+	static_assert(CHUNK_HEIGHT == 64, "column masks hold one chunk column per uint64_t");
+	uint64_t m_opaqueMask[CHUNK_SIZE][CHUNK_SIZE];
+	uint64_t m_transparentMask[CHUNK_SIZE][CHUNK_SIZE];
+	uint64_t m_waterMask[CHUNK_SIZE][CHUNK_SIZE];
 
 	World* m_world;
 
-	std::unique_ptr<Mesh> m_mesh;
-	std::unique_ptr<Mesh> m_activeMesh;
-	std::unique_ptr<Mesh> m_transparentMesh;
-	std::unique_ptr<Mesh> m_activeTransparentMesh;
+	std::unique_ptr<ChunkMesh> m_mesh;
+	std::unique_ptr<ChunkMesh> m_transparentMesh;
+
+	uint8_t m_dirtySections = 0;
+
+	// Occupied height range [min, max) of the meshed blocks
+	int m_minHeight = 0;
+	int m_maxHeight = 0;
+	uint8_t m_occluderHeights[OCCLUDER_TILES][OCCLUDER_TILES] = {};
+	uint16_t m_faceConnectivity = 0x7FFF;
 
-	void processDirection(const glm::ivec3& dir);
+	void updateHeightBounds();
 
-	std::pair<int, int> expandQuad(const glm::ivec3& startPos, const glm::vec3& dir,
-		BlockType blockType, const glm::ivec3& widthAxis, const glm::ivec3& heightAxis, std::array<float, 4>& ao);
+	void processDirection(const ChunkSnapshot& snapshot, MeshScratch& scratch, const glm::ivec3& dir, MeshData& opaque, MeshData& transparent) const;
 
-	void getExpansionAxes(const glm::vec3& dir, glm::ivec3& widthAxis, glm::ivec3& heightAxis);
+	static bool isBlockFaceVisible(const ChunkSnapshot& snapshot, int x, int y, int z, const glm::ivec3& dir, BlockType faceType);
 
-	bool isValidPosition(const glm::ivec3& pos);
+	static std::pair<int, int> expandQuad(const ChunkSnapshot& snapshot, MeshScratch& scratch, const glm::ivec3& startPos, const glm::vec3& dir,
+		BlockType blockType, const glm::ivec3& widthAxis, const glm::ivec3& heightAxis, uint8_t ao);
 
-	int getMaxHeight(const glm::ivec3& startPos, const glm::ivec3& heightAxis);
+	static void getExpansionAxes(const glm::vec3& dir, glm::ivec3& widthAxis, glm::ivec3& heightAxis);
 
-	void generateQuadGeometry(const Quad& quad, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec3>& textures, std::vector<float>& ao, std::vector<unsigned int>& indices);
+	static bool isValidPosition(const glm::ivec3& pos);
 
-	int getSurfaceY(int x, int z) const;
+	static int getMaxHeight(const glm::ivec3& startPos, const glm::ivec3& heightAxis);
 
-	void plantTree(int x, int y, int z);
+	static void generateQuadGeometry(const Quad& quad, MeshData& mesh);
 
-    BlockType getNeighborType(const glm::ivec3& pos, const glm::ivec3& dir) const;
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "chunk_mesh.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+// One large vertex buffer shared by every chunk mesh, sub-allocated in quads through a free list,
+// with the shared quad index buffer and a single VAO. Chunk meshes all live in it so the renderer
+// can draw a whole pass with one glMultiDrawElementsIndirect: the baseInstance of each command
+// picks the chunk origin from a per-draw attribute (location 1, divisor 1).
+// GL objects are created on first use, once a context exists.
+class ChunkArena {
+
+public:
+	ChunkArena() = default;
+	~ChunkArena();
+
+	ChunkArena(const ChunkArena&) = delete;
+	ChunkArena& operator=(const ChunkArena&) = delete;
+
+	// Reserve a range of quads and return its first quad, growing the buffer when no free block fits
+	uint32_t allocate(uint32_t quads);
+	void free(uint32_t firstQuad, uint32_t quads);
+
+	void upload(uint32_t firstQuad, const ChunkVertex* vertices, size_t quads);
+	// Copy quads inside the buffer, the ranges must not overlap
+	void copy(uint32_t srcQuad, uint32_t dstQuad, uint32_t quads);
+
+	// Grow the shared index buffer to hold at least quadCount quads
+	void reserveIndices(size_t quadCount);
+
+	// Bind the VAO for direct draws: the per-draw origin attribute is off and reads as origin
+	void bind(const glm::ivec3& origin);
+
+	// Per-draw chunk origins (xyz), indexed by the baseInstance of the indirect commands
+	void setDrawOrigins(const std::vector<glm::ivec4>& origins);
+
+	// Issue all commands in one call, returns the number of GL draw calls (0 or 1)
+	int drawIndirect(const std::vector<DrawElementsIndirectCommand>& commands);
+
+	// Bytes of the vertex buffer and of its allocated ranges
+	size_t getCapacityBytes() const;
+	size_t getUsedBytes() const;
+
+private:
+	static const uint32_t INITIAL_QUADS = 1 << 20;
+
+	unsigned int VAO = 0, VBO = 0;
+	unsigned int m_indexBuffer = 0;
+	unsigned int m_originBuffer = 0;
+	unsigned int m_indirectBuffer = 0;
+
+	uint32_t m_capacity = 0;  // in quads
+	uint32_t m_used = 0;
+	size_t m_indexQuadCapacity = 0;
+
+	// Free blocks, first quad -> size in quads; adjacent blocks are always merged
+	std::map<uint32_t, uint32_t> m_freeBlocks;
+
+	void init();
+	void grow(uint32_t minQuads);
+	void addFreeBlock(uint32_t firstQuad, uint32_t quads);
+	void bindVertexBuffer();
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// Packed chunk vertex, 8 bytes
+// position: x (6 bits) | y (7 bits) | z (6 bits) | face index (3 bits) | AO level (2 bits)
+// texture:  layer (8 bits) | u (7 bits) | v (7 bits), u and v span the greedy quad
+// Positions are local to the chunk and range up to the chunk size inclusive (quad corners).
+struct ChunkVertex {
+	uint32_t position;
+	uint32_t texture;
+
+	static inline ChunkVertex pack(int x, int y, int z, int face, int ao, int layer, int u, int v) {
+		return ChunkVertex{
+			uint32_t(x) | uint32_t(y) << 6 | uint32_t(z) << 13 | uint32_t(face) << 19 | uint32_t(ao) << 22,
+			uint32_t(layer) | uint32_t(u) << 8 | uint32_t(v) << 15
+		};
+	}
+};
+
+static_assert(sizeof(ChunkVertex) == 8, "ChunkVertex must stay 8 bytes");
+
+struct MeshData;
+class ChunkArena;
+struct DrawElementsIndirectCommand;
+
+// Chunk geometry made of quads, 4 packed vertices each, stored in a range of the shared ChunkArena.
+// All chunk meshes draw with one shared index buffer holding the pattern 4q + {0, 1, 2, 2, 1, 3},
+// quads that need their other diagonal are emitted with their corners reordered.
+//
+// Quads are grouped by chunk section (quads never cross a section) and, within a section, added
+// face by face in face index order. Each section owns a slot of the mesh range with some spare
+// room, so a remeshed section is patched in place; face directions are contiguous ranges that
+// can be skipped at draw time when they face away from the camera.
+class ChunkMesh {
+
+public:
+	static const int SECTION_COUNT = 4;
+	static const uint8_t ALL_FACES = 0x3F;
+
+	explicit ChunkMesh(ChunkArena& arena);
+	~ChunkMesh();
+
+	ChunkMesh(const ChunkMesh&) = delete;
+	ChunkMesh& operator=(const ChunkMesh&) = delete;
+
+	// Upload the sections in data->sectionMask, in place when they fit their slot; the first upload,
+	// or one holding every section, replaces the whole mesh. With keepCpuData the mesh takes ownership
+	// of the uploaded buffers as its CPU copy, otherwise it only keeps counts and GL handles.
+	// No vertex is copied on the CPU: data is left holding the buffers to recycle.
+	void upload(std::unique_ptr<MeshData>& data, bool keepCpuData);
+
+	// Draw the faces whose bit is set in faceMask (bit i for face index i) at the chunk origin,
+	// returns the number of quads drawn
+	size_t draw(const glm::ivec3& origin, uint8_t faceMask = ALL_FACES) const;
+
+	// Same selection as draw, appended as indirect commands reading the chunk origin at baseInstance
+	size_t appendDrawCommands(uint8_t faceMask, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) const;
+
+	size_t getQuadCount() const;
+	size_t getSectionQuadCount(int section) const { return m_sections[section].quadCount; }
+	size_t getFaceQuadCount(int section, int face) const { return m_sections[section].faceQuadCount[face]; }
+
+	// CPU copy of the uploaded geometry, null for GPU-resident meshes
+	const MeshData* getData() const { return m_data.get(); }
+
+	// Bytes held by the CPU copy and by the vertex buffer
+	size_t getCpuMemoryUsage() const;
+	size_t getGpuMemoryUsage() const;
+
+private:
+	struct Section {
+		std::array<uint32_t, 6> faceQuadCount{};
+		uint32_t quadCount = 0;
+		uint32_t firstQuad = 0;  // start of the slot in the vertex buffer
+		uint32_t capacity = 0;   // slot size in quads
+	};
+
+	std::array<Section, SECTION_COUNT> m_sections;
+	std::unique_ptr<MeshData> m_data;
+
+	ChunkArena& m_arena;
+	uint32_t m_firstQuad;    // start of the mesh range in the arena
+	uint32_t m_bufferQuads;  // size of the range
+	bool m_isSetup;
+
+	// Index range of consecutive enabled faces of a section
+	struct Run {
+		uint32_t count;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+	};
+	static const int MAX_RUNS = SECTION_COUNT * 3;
+
+	// Collect the runs of the faces in faceMask, returns the number of quads they cover
+	size_t collectRuns(uint8_t faceMask, Run (&runs)[MAX_RUNS], int& runCount) const;
+
+	// Lay out the slots in a new arena range, uploading the sections in uploadMask from source.
+	// The others keep their current content, copied on the GPU from the previous range.
+	void allocate(uint8_t uploadMask, const MeshData& source);
+
+	static uint32_t slotCapacity(size_t quads);
+};
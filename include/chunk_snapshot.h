@@ -0,0 +1,46 @@
+#pragma once
+
+#include "chunk.h"
+#include <cstdint>
+
+// Immutable copy of a chunk plus a one-voxel border from its neighbors, captured on the main thread
+// when a mesh job is enqueued. Meshing reads only from the snapshot, so it needs no hash lookups
+// and never races with the main thread editing or unloading chunks.
+struct ChunkSnapshot {
+	static const int SIZE = Chunk::CHUNK_SIZE + 2;
+	static const int HEIGHT = Chunk::CHUNK_HEIGHT + 2;
+
+	// Block types in padded coordinates (local + 1). The rows above and below the chunk
+	// stay empty as there are no chunks stacked vertically.
+	BlockType blocks[SIZE][HEIGHT][SIZE];
+
+	// Column masks in padded x/z coordinates, bit y is local height y (see Chunk::getOpaqueColumn)
+	uint64_t opaque[SIZE][SIZE];
+	uint64_t filled[SIZE][SIZE];
+	uint64_t solid[SIZE][SIZE];
+	uint64_t water[SIZE][SIZE];
+
+	// Uniform sections of the chunk itself
+	bool sectionUniform[Chunk::SECTION_COUNT];
+	BlockType sectionType[Chunk::SECTION_COUNT];
+
+	// Sections to mesh (bit s for section s), the others are left out of the generated meshes
+	uint8_t sectionMask = Chunk::ALL_SECTIONS;
+
+	// Mesher settings at capture time
+	bool binaryMesher = true;
+
+	// Horizontal neighbors of a chunk indexed [dx + 1][dz + 1], null where missing (the center is unused)
+	using Neighbors = const Chunk* [3][3];
+
+	void capture(const Chunk& chunk, const Neighbors& neighbors);
+
+	// Accessors take local chunk coordinates, valid from -1 to size inclusive
+	inline BlockType get(int x, int y, int z) const {
+		return blocks[x + 1][y + 1][z + 1];
+	}
+
+	inline bool isSolid(int x, int y, int z) const {
+		return (y >= 0 && y < Chunk::CHUNK_HEIGHT) && ((solid[x + 1][z + 1] >> y) & 1);
+	}
+};
@@ -5,8 +5,9 @@
 #include <memory>
 #include "mesh.h"
 #include <array>
+#include <cstdint>
 
-enum class BlockType {
+enum class BlockType : uint8_t {
 	None = 0,
 	Grass,
 	Dirt,
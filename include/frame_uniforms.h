@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Per-frame values shared by every shader, laid out as the std140 FrameUniforms block
+// (binding FrameUniforms::BINDING) declared at the top of the shaders.
+struct FrameUniformData {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 sunDirection;    // xyz
+	glm::vec4 horizonColor;    // rgb
+	glm::vec4 zenithColor;     // rgb
+	float lightIntensity;
+	float padding[3];
+};
+
+static_assert(sizeof(FrameUniformData) == 192, "FrameUniformData must match the std140 FrameUniforms block");
+
+// Uniform buffer holding FrameUniformData, bound once to its binding point. Programs read it
+// through the binding declared in their block, so a frame costs one upload and no uniform lookups.
+class FrameUniforms {
+
+public:
+	static const unsigned int BINDING = 0;
+
+	FrameUniforms() = default;
+	~FrameUniforms();
+
+	FrameUniforms(const FrameUniforms&) = delete;
+	FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+	// Create the buffer and bind it, needs a GL context
+	void init();
+
+	void update(const FrameUniformData& data);
+
+private:
+	unsigned int m_buffer = 0;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// View frustum as 6 planes extracted from a view-projection matrix (Gribb-Hartmann).
+// Planes point inward: a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all of them.
+class Frustum {
+
+public:
+	Frustum() = default;
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	// Conservative box test: false only when the box is entirely outside one plane
+	bool isBoxVisible(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+	glm::vec4 m_planes[6];
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file (mmap on POSIX, a file mapping on Windows).
+// The pages are loaded on first access, so reading an asset costs no copy into a buffer.
+class MappedFile {
+
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* filePath);
+	void close();
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
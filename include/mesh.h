@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <array>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -70,9 +71,12 @@ class Mesh {
 
 public:
 	Mesh();
-    Mesh(Mesh* other);
     ~Mesh();
 
+	// Owns its GL objects, copies would delete them twice
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
 	void createCube();
 
     void  createQuad();
@@ -113,11 +117,11 @@ private:
 
 };
 
-enum class BlockType;
+enum class BlockType : uint8_t;
 struct Quad {
 	glm::vec3 position; // Position of the quad
 	glm::vec2 size; // Size of the quad (width, height)
     glm::vec3 direction; // Direction of the quad (0-5 for each face)
 	BlockType type; // Type of block (for texture mapping)
-    std::array<float, 4> ao; // Ambient occlusion values for the 4 corners of the quad
+    uint8_t ao; // Ambient occlusion levels of the 4 corners of the quad, 2 bits each (see m_aoLevelTable)
 };;
\ No newline at end of file
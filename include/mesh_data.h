@@ -0,0 +1,53 @@
+#pragma once
+
+#include "chunk_mesh.h"
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// CPU geometry of a chunk as produced by a mesh job: packed quads per section, each section
+// laid out face by face (see ChunkMesh). Move-only, it travels from the worker to the upload
+// stage by ownership transfer and its buffers are recycled through a MeshDataPool.
+struct MeshData {
+	struct Section {
+		std::vector<ChunkVertex> vertices;
+		std::array<uint32_t, 6> faceQuadCount{};
+		uint32_t quadCount = 0;
+	};
+
+	std::array<Section, ChunkMesh::SECTION_COUNT> sections;
+
+	// Sections this data holds (bit s for section s), the others are left untouched on upload
+	uint8_t sectionMask = 0;
+
+	MeshData() = default;
+	MeshData(const MeshData&) = delete;
+	MeshData& operator=(const MeshData&) = delete;
+	MeshData(MeshData&&) = default;
+	MeshData& operator=(MeshData&&) = default;
+
+	// Corners in the order bottom-left, bottom-right, top-left, top-right
+	void addQuad(int section, const ChunkVertex& v1, const ChunkVertex& v2, const ChunkVertex& v3, const ChunkVertex& v4, bool flip);
+
+	// Empty every section, keeping the allocated buffers
+	void clear();
+
+	size_t getQuadCount() const;
+};
+
+// Thread-safe free list of MeshData, so mesh jobs reuse buffers that already have the capacity of a typical section
+class MeshDataPool {
+
+public:
+	static const size_t RESERVED_VERTICES = 4096;
+	static const size_t MAX_FREE = 32;
+
+	std::unique_ptr<MeshData> acquire();
+	void release(std::unique_ptr<MeshData> data);
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<MeshData>> m_free;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "chunk.h"
+#include "binary_mesher.h"
+#include <vector>
+#include <cstdint>
+
+// Working memory of one meshing worker, reused by every job that worker runs.
+// World keeps one per mesh thread so chunks only hold their block data and meshes.
+struct MeshScratch {
+	static const int SIZE = Chunk::CHUNK_SIZE;
+	static const int HEIGHT = Chunk::CHUNK_HEIGHT;
+
+	// Per-cell mesher state for the current direction, indexed [x][y][z]
+	bool visited[SIZE][HEIGHT][SIZE];
+	bool visibility[SIZE][HEIGHT][SIZE];
+	uint8_t ao[SIZE][HEIGHT][SIZE];
+
+	// Connectivity flood fill (see VisibilityGraph): filled or opaque cells per column, and the
+	// pending column spans
+	struct FloodStep {
+		int x, z;
+		uint64_t cells;
+	};
+	uint64_t floodVisited[SIZE][SIZE];
+	std::vector<FloodStep> floodStack;
+
+	BinaryMesher binaryMesher;
+};
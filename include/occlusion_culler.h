@@ -0,0 +1,82 @@
+#pragma once
+
+#include "thread.h"
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <future>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VOXL_OCCLUSION_SSE 1
+#endif
+
+// Software occlusion culling on the CPU, independent of OpenGL.
+// Occluder boxes (volumes known to be fully solid) are rasterized into a small depth buffer, storing
+// NDC depth. Rasterization is conservative: a pixel is written only when the triangle covers all of
+// it, with the farthest depth the triangle has inside it. A hierarchical-Z pyramid keeping the
+// farthest depth of each 2x2 block then answers box queries: a box is hidden when its nearest
+// point lies behind every covered texel of the pyramid level its screen rectangle spans.
+class OcclusionCuller {
+
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 128;
+
+	struct Box {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	OcclusionCuller();
+
+	// Synchronous use: clear the depth buffer for a camera, rasterize occluders, build the pyramid, query
+	void beginFrame(const glm::mat4& viewProjection, const glm::vec3& eye);
+	void rasterizeBox(const Box& box);
+	void buildHiZ();
+	bool isBoxVisible(const Box& box) const;
+
+	// Occluder boxes for a grid of solid columns standing on origin.y, heights[z * columns + x] with 0
+	// for no column. The outer ring of the grid only gives neighbor heights, it is not added.
+	// A padding shrinks the union of the columns by that distance (at most columnSize): tops and
+	// bottoms always, sides only where a neighbor is lower, so adjacent columns leave no cracks.
+	static void addColumnOccluders(const std::vector<int>& heights, int columns, int rows, const glm::vec3& origin,
+		float columnSize, float padding, std::vector<Box>& out);
+
+	// Run a whole frame on the culler worker thread: one visibility flag per candidate, read them with
+	// waitResults. The inputs are swapped into the culler, the vectors come back empty.
+	void cullAsync(const glm::mat4& viewProjection, const glm::vec3& eye, std::vector<Box>& occluders, std::vector<Box>& candidates);
+	const std::vector<uint8_t>& waitResults();
+
+	// Vectorized rasterizer when built with SSE2, the scalar one gives the same depth buffer
+	bool useSimd = true;
+
+	// Boxes partly off screen count as visible, for results reused after the camera turned
+	bool partialBoxesVisible = false;
+
+	const std::vector<float>& getDepthBuffer() const { return m_levels[0]; }
+
+private:
+	glm::mat4 m_viewProjection;
+	glm::vec3 m_eye;
+
+	// Level 0 is the depth buffer, level i is WIDTH >> i by HEIGHT >> i
+	std::vector<std::vector<float>> m_levels;
+
+	std::vector<Box> m_occluders;
+	std::vector<Box> m_candidates;
+	std::vector<uint8_t> m_results;
+	std::future<void> m_pending;
+
+	// Declared last so its worker is joined before the buffers it uses are freed
+	ThreadPool m_worker{ 1 };
+
+	// Screen-space vertex: pixel coordinates and NDC depth
+	struct ScreenVertex {
+		float x, y, z;
+	};
+
+	void rasterizeQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d);
+	void rasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2);
+	ScreenVertex toScreen(const glm::vec4& clip) const;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+// 2D Perlin noise evaluated over a grid of integer positions at once, several columns per
+// instruction. The result matches fnlGetNoise2D for an FNL_NOISE_PERLIN state without fractal
+// (same hash, gradients and interpolation, no fused multiply-add), so terrain is the same on
+// every path. The widest path the CPU supports is picked at runtime.
+class PerlinBatch {
+
+public:
+	enum class Path { Scalar, SSE41, AVX2 };
+
+	PerlinBatch(int seed, float frequency);
+
+	// Noise at (originX + x, originZ + z) for x < width and z < depth, written to out[z * width + x]
+	void sampleGrid(int originX, int originZ, int width, int depth, float* out) const;
+	void sampleGrid(int originX, int originZ, int width, int depth, float* out, Path path) const;
+
+	// Single position, same result as the grid
+	float sample(int x, int z) const;
+
+	static bool isSupported(Path path);
+	static Path getBestPath();
+	static const char* getPathName(Path path);
+
+	int getSeed() const { return m_seed; }
+	float getFrequency() const { return m_frequency; }
+
+private:
+	int m_seed;
+	float m_frequency;
+
+	void sampleRowScalar(int originX, int width, int z, float* out) const;
+	void sampleRowSSE41(int originX, int width, int z, float* out) const;
+	void sampleRowAVX2(int originX, int width, int z, float* out) const;
+};
@@ -22,6 +22,10 @@ public:
 
     const glm::vec3& getWorldPosition() const { return m_position; }
 
+	glm::vec3 getCameraPosition() const {
+		return m_camera->getWorldPosition();
+	}
+
 	glm::mat4 getView() const {
 		return m_camera->getViewMatrix();
 	}
@@ -76,11 +80,6 @@ private:
     float m_height = 1.75f;
     float m_width = 0.35f;
 
-    std::unordered_set<BlockType> m_nonSelectableBlockTypes = { 
-        BlockType::Water, 
-        BlockType::None 
-    };
-
     std::unique_ptr<Camera> m_camera;
     World* m_world;
 
@@ -2,10 +2,14 @@
 
 #include "subsystem.h"
 #include "shader.h"
+#include "shader_variants.h"
 #include <GLFW/glfw3.h>
 #include <vector>
 #include <memory>
 #include <world.h>
+#include "occlusion_culler.h"
+#include "visibility_graph.h"
+#include "frame_uniforms.h"
 
 class Renderer : public ISubsystem
 {
@@ -26,20 +30,96 @@ public:
 	GLFWwindow* window;
 	unsigned int m_crosshairTextureId = 0;
 
+	// Triangles submitted for chunks last frame, after skipping faces pointing away from the camera
+	size_t getChunkTriangles() const { return m_chunkTriangles; }
+	size_t getChunkTrianglesTotal() const { return m_chunkTrianglesTotal; }
+
+	// GL draw calls issued for chunks last frame
+	int getChunkDrawCalls() const { return m_chunkDrawCalls; }
+
+	// Chunks of the render list drawn and skipped by frustum culling last frame
+	size_t getChunksVisible() const { return m_visibleChunks.size(); }
+	int getChunksCulled() const { return m_chunksCulled; }
+	// Chunks in the frustum hidden behind nearer terrain last frame
+	int getChunksOccluded() const { return m_chunksOccluded; }
+	// Time the last frame blocked on the occlusion worker, in milliseconds
+	float getOcclusionWaitMs() const { return m_occlusionWaitMs; }
+	// Chunks in the frustum no open path from the camera chunk reaches last frame
+	int getChunksUnreachable() const { return m_chunksUnreachable; }
+
 private:
 
 	World* world; // Reference to the world object
 
-	std::unique_ptr<Shader> shader;
+	// Chunk program variants, bits of ChunkShaderFeature in the order of the defines they add
+	enum ChunkShaderFeature : uint32_t {
+		ChunkAmbientOcclusion = 1 << 0,  // AMBIENT_OCCLUSION: shade with the baked AO levels
+		ChunkWireframe = 1 << 1,         // WIREFRAME: no alpha test, lines of cut-out blocks stay
+	};
+	std::unique_ptr<ShaderVariants> m_chunkShaders;
 	std::unique_ptr<Shader> highlightShader;
 	std::unique_ptr<Shader> skyShader;
 
+	// Uniforms set every frame, resolved once the programs are linked
+	UniformHandle m_highlightModel;
+
 	std::unique_ptr<Mesh> cubeMesh;
 
 	std::unique_ptr<Skybox> skybox;
 
+	FrameUniforms m_frameUniforms;
+
+	size_t m_chunkTriangles = 0;
+	size_t m_chunkTrianglesTotal = 0;
+	int m_chunkDrawCalls = 0;
+	int m_chunksCulled = 0;
+	int m_chunksOccluded = 0;
+	int m_chunksUnreachable = 0;
+
+	// Chunks passing frustum and occlusion culling this frame, and the render queue indices passing frustum culling
+	std::vector<Chunk*> m_visibleChunks;
+	std::vector<size_t> m_visibleIndices;
+
+	// Nearest chunks whose solid tiles are rasterized as occluders, with the tile heights of the
+	// square of chunks around them
+	static const size_t OCCLUDER_CHUNKS = 32;
+	OcclusionCuller m_occlusionCuller;
+	std::vector<int> m_occluderHeights;
+	std::vector<OcclusionCuller::Box> m_occluders;
+	std::vector<OcclusionCuller::Box> m_occlusionCandidates;
+
+	// Occlusion results are used one frame late, so the worker runs alongside a whole frame.
+	// The job shrinks occluders and grows candidates by a padding, its results hold as long
+	// as the eye stays within that distance of the job's eye (turning the camera is fine).
+	static constexpr float OCCLUSION_MIN_PADDING = 0.5f;
+	bool m_occlusionPending = false;
+	glm::vec3 m_occlusionEye{ 0.0f };
+	float m_occlusionPadding = 0.0f;
+	std::vector<glm::ivec3> m_occlusionChunks;  // grid position of each candidate of the pending job
+	std::unordered_set<glm::ivec3> m_occludedChunks;
+	glm::vec3 m_lastEye{ 0.0f };
+	float m_occlusionWaitMs = 0.0f;
+
+	VisibilityGraph m_visibilityGraph;
+	std::unordered_set<const Chunk*> m_reachableChunks;
+
+	// Indirect draw lists, rebuilt every frame
+	std::vector<glm::ivec4> m_chunkOrigins;
+	std::vector<DrawElementsIndirectCommand> m_opaqueCommands;
+	std::vector<DrawElementsIndirectCommand> m_transparentCommands;
+
+	uint32_t getChunkShaderFeatures() const;
+	// Print how each startup program was built (binary cache or compiled) and how long it took
+	void reportShaderStartup(const std::vector<const Shader*>& programs) const;
+
 	void renderSky();
 	void render();
+	// Queue an occlusion test of the render queue on the culler worker, for the next frame
+	void startOcclusionCulling(const glm::mat4& viewProjection, const glm::vec3& eye);
+	// Take the results of the job queued last frame, dropped if the eye moved past its padding
+	void collectOcclusionResults(const glm::vec3& eye);
+	// Both chunk passes as one multi-draw-indirect call each
+	void renderChunksIndirect(const glm::vec3& eye, size_t& drawnQuads);
 	void renderUI();
 	void swapBuffers();
 };
\ No newline at end of file
@@ -1,23 +1,85 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
 #include <glm/glm.hpp>
 
+// FNV-1a hash of a uniform name
+constexpr uint32_t hashUniformName(std::string_view name)
+{
+	uint32_t hash = 2166136261u;
+	for (char c : name) {
+		hash = (hash ^ uint8_t(c)) * 16777619u;
+	}
+	return hash;
+}
+
+// Uniform name from a string literal, hashed at compile time
+struct UniformName {
+	const char* name;
+	uint32_t hash;
+
+	template<size_t N>
+	consteval UniformName(const char (&literal)[N]) : name(literal), hash(hashUniformName(std::string_view(literal, N - 1))) {}
+};
+
+// Location of a uniform in one program, resolved once with Shader::getUniform.
+// A uniform the program does not use keeps location -1, which GL ignores on set.
+struct UniformHandle {
+	int location = -1;
+
+	bool isValid() const { return location >= 0; }
+};
+
 class Shader
 {
 private:
 	unsigned int m_shaderID;
 	std::string m_vertexFilePath;
 	std::string m_fragmentFilePath;
-	std::unordered_map<std::string, int> m_UniformLocationCache; // Cache for uniforms
+	std::vector<std::string> m_defines;
+	std::vector<std::pair<uint32_t, int>> m_uniforms; // Active uniforms of the linked program, name hash -> location, sorted by hash
+
+	static const int MAX_INCLUDE_DEPTH = 8;
+
+	// Startup cost of the program and where it came from
+	double m_loadTimeMs = 0.0;
+	bool m_loadedFromCache = false;
+
+	// Program binary cache file: header, driver string, then the binary
+	struct BinaryCacheHeader {
+		static const uint32_t MAGIC = 0x50584F56; // "VOXP"
+		uint64_t sourceHash;
+		uint32_t magic;
+		uint32_t driverLength;
+		uint32_t format;
+		uint32_t binaryLength;
+	};
+	static inline std::string s_binaryCacheDirectory;
 
 	unsigned int compile();
-	int getUniformLocation(const std::string& name);
+
+	// Read a stage source, replacing #include "file" lines by the file content
+	static bool loadSource(const std::string& filePath, std::string& source, int depth);
+	// Full source of a stage: includes resolved and the defines added after #version
+	bool preprocess(const std::string& filePath, std::string& source) const;
+	void collectUniforms();
+
+	static bool isBinaryCacheAvailable();
+	static uint64_t hashSource(const std::string& vertexSource, const std::string& fragmentSource);
+	static std::string getDriverString();
+	static std::string getBinaryCachePath(uint64_t sourceHash);
+	// Linked program from the cache, 0 when missing, stale or rejected by the driver
+	static unsigned int loadProgramBinary(uint64_t sourceHash);
+	static void saveProgramBinary(unsigned int program, uint64_t sourceHash);
 
 public:
-	Shader(const std::string& vertexFilePath, const std::string& fragmentFilePath);
+	// Each define is added to both stages as "#define <define>"
+	Shader(const std::string& vertexFilePath, const std::string& fragmentFilePath, const std::vector<std::string>& defines = {});
 	~Shader();
 
 	void bind() const;
@@ -25,15 +87,29 @@ public:
 
 	unsigned int getID() const { return m_shaderID; }
 
-	// Set uniforms
-	void setUniform1i(const std::string& name, int value);
-	void setUniform1f(const std::string& name, float value);
-	void setUniform2f(const std::string& name, float v0, float v1);
-	void setUniform3f(const std::string& name, float v0, float v1, float v2);
-	void setUniform4f(const std::string& name, float v0, float v1, float v2, float v3);
-	void setUniformMat3f(const std::string& name, const glm::mat3& matrix);
-	void setUniformMat4f(const std::string& name, const glm::mat4& matrix);
-	void setUniformVec3f(const std::string& name, const glm::vec3& vector);
-	void setUniformBool(const std::string& name, bool value);
-	void setUniform3fv(const std::string& name, const std::vector<glm::vec3> vector, int count);
+	// Linked programs are cached in directory, keyed by the hash of their preprocessed sources and
+	// checked against the driver vendor, renderer and version. Empty disables the cache.
+	static void setBinaryCacheDirectory(const std::string& directory);
+
+	// Time spent building the program, and whether it came from the binary cache
+	double getLoadTimeMs() const { return m_loadTimeMs; }
+	bool isLoadedFromCache() const { return m_loadedFromCache; }
+	const std::string& getVertexFilePath() const { return m_vertexFilePath; }
+	const std::string& getFragmentFilePath() const { return m_fragmentFilePath; }
+
+	// Look up a uniform of the linked program; warns when the program does not use it.
+	// Resolve handles once after construction, the setters then go straight to GL.
+	UniformHandle getUniform(UniformName name) const;
+
+	// Set uniforms of the bound program
+	void setUniform1i(UniformHandle handle, int value);
+	void setUniform1f(UniformHandle handle, float value);
+	void setUniform2f(UniformHandle handle, float v0, float v1);
+	void setUniform3f(UniformHandle handle, float v0, float v1, float v2);
+	void setUniform4f(UniformHandle handle, float v0, float v1, float v2, float v3);
+	void setUniformMat3f(UniformHandle handle, const glm::mat3& matrix);
+	void setUniformMat4f(UniformHandle handle, const glm::mat4& matrix);
+	void setUniformVec3f(UniformHandle handle, const glm::vec3& vector);
+	void setUniformBool(UniformHandle handle, bool value);
+	void setUniform3fv(UniformHandle handle, const std::vector<glm::vec3>& vector, int count);
 };
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "shader.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+// Specialized programs built from one vertex/fragment pair, one per combination of feature bits.
+// Bit i of a key defines features[i] in both stages, so the shaders select their code paths with
+// #ifdef at compile time instead of branching on uniforms. Programs are compiled on first use and
+// kept for the lifetime of the cache.
+class ShaderVariants {
+
+public:
+	ShaderVariants(const std::string& vertexFilePath, const std::string& fragmentFilePath, const std::vector<std::string>& features);
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	Shader& get(uint32_t featureBits);
+
+	// Programs compiled so far
+	size_t getCount() const { return m_programs.size(); }
+
+private:
+	std::string m_vertexFilePath;
+	std::string m_fragmentFilePath;
+	std::vector<std::string> m_features;
+
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>> m_programs;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <FastNoiseLite.h>
+#include "perlin_batch.h"
+
+class Chunk;
+
+// Terrain of the world for a given seed. The noise settings are fixed at construction and never
+// written again, so generate is a pure function of the chunk position: any number of worker
+// threads can call it at once, and the same seed always gives the same terrain.
+class TerrainGenerator {
+
+public:
+	static const int DEFAULT_SEED = 1337;
+
+	explicit TerrainGenerator(int seed = DEFAULT_SEED);
+
+	// Fill a freshly constructed (all air) chunk with the terrain at grid position chunkCoord
+	void generate(const glm::ivec3& chunkCoord, Chunk& out) const;
+
+	int getSeed() const { return m_seed; }
+
+private:
+	int m_seed;
+	PerlinBatch m_heightNoise;
+	fnl_state m_treeNoise;
+
+	static void plantTree(Chunk& chunk, int x, int y, int z);
+};
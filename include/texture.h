@@ -17,13 +17,17 @@ public:
 
 	bool loadFromFile(const char* filePath);
 	bool loadTextureArrayFromFile(const char* filePath, int cols, int rows);
+	// Texture array from a pack built by tools/texture_packer, returns false when missing or invalid
+	bool loadTextureArrayFromPack(const char* filePath);
 	bool loadCubemap(const char* filePath);
 	void bind(unsigned int slot = 0) const;
 	void bindCubemap(unsigned int slot = 0) const;
 	void unbind() const;
 	unsigned int getID() const { return m_textureID; }
+	int getLayerCount() const { return m_layerCount; }
 
 private:
 
 	unsigned int m_textureID;
+	int m_layerCount = 0;
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Binary texture array asset, built offline by tools/texture_packer from an atlas image.
+// Layout: header, one TexturePackLevel per mip level, then the pixel data of each level.
+// A level holds every layer back to back (RGBA8, bottom row first as GL expects), so it
+// uploads with a single glTexSubImage3D straight from the mapped file.
+struct TexturePackHeader {
+	static const uint32_t MAGIC = 0x50545856; // "VXTP"
+	static const uint32_t VERSION = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t layerWidth;
+	uint32_t layerHeight;
+	uint32_t layerCount;
+	uint32_t mipLevels;
+};
+
+struct TexturePackLevel {
+	uint64_t offset;  // from the start of the file
+	uint64_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+static_assert(sizeof(TexturePackHeader) == 24 && sizeof(TexturePackLevel) == 24, "texture pack structs are written as is");
+
+struct TexturePack {
+	static const uint32_t MAX_LEVELS = 16;
+
+	// Slice an RGBA8 atlas of cols x rows tiles into layers (layer = row * cols + col) and append
+	// the full mip chain, box filtered like glGenerateMipmap. Returns the file content.
+	static bool build(const uint8_t* atlas, int atlasWidth, int atlasHeight, int cols, int rows, std::vector<uint8_t>& pack, std::string& error);
+
+	// Check a pack in memory, the returned pointers point into data
+	static bool parse(const uint8_t* data, size_t size, const TexturePackHeader*& header, const TexturePackLevel*& levels, std::string& error);
+};
@@ -1,7 +1,7 @@
 #pragma once
 #include <vector>
 #include <thread>
-#include <queue>
+#include <deque>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
@@ -11,11 +11,20 @@ public:
     ThreadPool(size_t numThreads);
     ~ThreadPool();
 
-    void enqueue(std::function<void()> job);
+    // Run every queued job and stop the workers, no job can be enqueued afterwards
+    void join();
+
+    // Urgent jobs run before the ones already waiting
+    void enqueue(std::function<void()> job, bool urgent = false);
+
+    size_t size() const { return workers.size(); }
+
+    // Index of the pool worker running the calling thread, -1 outside of any pool
+    static int workerIndex();
 
 private:
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::deque<std::function<void()>> tasks;
     std::mutex queueMutex;
     std::condition_variable condition;
     bool stop;
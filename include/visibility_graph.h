@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+
+class World;
+class Chunk;
+class Frustum;
+struct ChunkSnapshot;
+struct MeshScratch;
+
+// Chunk-level visibility through open space. At mesh time a flood fill over the non-opaque cells of
+// a chunk finds which of its 6 faces see each other (15 face pairs, one bit each). At render time a
+// breadth-first walk from the camera chunk only crosses a chunk from the face it entered by to a face
+// connected to it, never steps back towards the camera and stays in the frustum. Chunks it does not
+// reach (sealed caves, valleys behind solid ground) cannot be seen.
+class VisibilityGraph {
+
+public:
+	static const uint16_t ALL_CONNECTED = 0x7FFF;
+
+	// Face pair connectivity of the chunk in a snapshot, faces indexed like the mesh face indices
+	static uint16_t computeConnectivity(const ChunkSnapshot& snapshot, MeshScratch& scratch);
+
+	static int pairBit(int faceA, int faceB);
+	static bool isConnected(uint16_t connectivity, int faceA, int faceB) {
+		return faceA == faceB || ((connectivity >> pairBit(faceA, faceB)) & 1);
+	}
+
+	// Collect the chunks reachable from the camera into reachable. Returns false when the camera
+	// is not inside a loaded chunk, every chunk should then be treated as reachable.
+	bool findReachable(const World& world, const glm::vec3& eye, const Frustum& frustum, std::unordered_set<const Chunk*>& reachable);
+
+private:
+	struct Step {
+		const Chunk* chunk;
+		int entryFace;         // face of chunk the walk came in by, -1 for the camera chunk
+		uint8_t directions;    // face directions taken so far, bit i for face index i
+	};
+
+	std::vector<Step> m_queue;
+};
@@ -9,10 +9,15 @@
 #include <iostream>
 #include <queue>
 #include <set>
-#include <FastNoiseLite.h>
+#include "terrain_generator.h"
 #include "thread.h"
+#include "mesh_data.h"
+#include "chunk_arena.h"
+#include <atomic>
 #include <skybox.h>
 
+struct MeshScratch;
+
 struct SkyPalette {
 	glm::vec3 horizon; 
 	glm::vec3 zenith;
@@ -43,7 +48,11 @@ static const size_t WORKER_COUNT = 4;
 	virtual void shutdown() override;
 
 
-	void updateChunk(Chunk* chunk);
+	// Queue a remesh of some sections of a chunk (bit s for section s), ignored until its four neighbors are generated
+	void requestMesh(Chunk* chunk, uint8_t sectionMask = Chunk::ALL_SECTIONS);
+
+	// Remesh after a block edit: only the sections the block touches, and the neighbors sharing its border
+	void updateBlock(Chunk* chunk, const glm::ivec3& localPos);
 
 	void setPlayer(Player* player) {
 		m_player = player;
@@ -54,7 +63,7 @@ static const size_t WORKER_COUNT = 4;
 		auto it = m_chunks.find(pos);
 		if (it == m_chunks.end()) {
 			m_chunks[pos] = chunk; // Store the Chunk pointer
-			m_chunksToGenerate.insert(chunk); // Add to update list
+			requestMesh(chunk); // Add to update list
 		}
 		else {
 			std::cerr << "A Chunk already exists at this location in the world!" << std::endl;
@@ -81,17 +90,48 @@ static const size_t WORKER_COUNT = 4;
 
 	std::unordered_map<glm::ivec3, Chunk*>& getChunks() { return m_chunks; }
 	std::set<Chunk*>& getRenderList() { return m_chunksToRender; }
+
+	struct RenderQueueEntry {
+		Chunk* chunk;
+		float distance;  // squared, from the camera to the chunk box center
+	};
+
+	// Chunks whose terrain is still being generated
+	size_t getChunksGenerating() const { return m_chunksLoading.size(); }
+
+	// Rendered chunks ordered nearest first, re-sorted every update as the camera moves
+	const std::vector<RenderQueueEntry>& getRenderQueue() const { return m_renderQueue; }
 	Player* getPlayer() const { return m_player; }
 
 	float getLightIntensity() const { return m_lightIntensity; }
 	SkyPalette getSkyColor() const { return m_skyColor; }
 	glm::vec3 getSunDir() const { return m_sunDir; }
 
+	// Toggle ambient occlusion shading, a switch of chunk program without remeshing
 	void setAmbientOcclusion();
 
-	fnl_state noise;
+	// Switch between the binary and the per-cell greedy mesher and remesh the world
+	void setBinaryMesher();
+
+	// Average worker time spent meshing one chunk, in milliseconds
+	float getMeshTimeMs() const;
+
+	// Switch between GPU-resident chunk meshes and meshes keeping a CPU copy, and remesh the world
+	void setGpuResidentMeshes();
+
+	// Bytes held by the rendered chunk meshes on the CPU and in vertex buffers
+	void getMeshMemoryUsage(size_t& cpuBytes, size_t& gpuBytes) const;
+
+	// Vertex storage shared by all chunk meshes
+	ChunkArena& getMeshArena() { return m_meshArena; }
+
 
 	bool useAmbientOcclusion = true;
+	bool useBinaryMesher = true;
+	bool gpuResidentMeshes = true;
+	bool useIndirectDraw = true;
+	bool useOcclusionCulling = true;
+	bool useConnectivityCulling = true;
 	
 	float dayTimer = 0.0f; 
 	float dayLength = 0.0f; 
@@ -106,6 +146,7 @@ private:
 	std::unordered_set<glm::ivec3> m_chunksToRemove; 
 	std::set<Chunk*> m_chunkMeshesToSetup; 
 	std::set<Chunk*> m_chunksToRender;
+	std::vector<RenderQueueEntry> m_renderQueue;
 
 	// std::vector<Chunk*> m_chunks;
 	std::unordered_map<glm::ivec3, Chunk*> m_chunks;
@@ -131,17 +172,47 @@ private:
 
 	glm::vec3 m_sunDir;
 
+	// Read-only once constructed, shared by every generation job
+	const TerrainGenerator m_terrain{ TerrainGenerator::DEFAULT_SEED };
+
+	// Outlives the chunks, whose meshes return their ranges to it
+	ChunkArena m_meshArena;
+
 	// Multi-threading
-	ThreadPool meshThreadPool{ WORKER_COUNT };
+	// Generated payloads on their way from a mesh worker to the GL upload in setupChunks
+	struct MeshResult {
+		Chunk* chunk = nullptr;
+		std::unique_ptr<MeshData> opaque;
+		std::unique_ptr<MeshData> transparent;
+		uint16_t connectivity = 0;
+	};
+
+	// Everything the jobs write to is declared before the thread pool, so it outlives the workers
+	std::vector<std::unique_ptr<MeshScratch>> meshScratch;
+	MeshDataPool meshDataPool;
 	std::mutex meshResultMutex;
-	std::queue<Chunk*> meshResults;
+	std::queue<MeshResult> meshResults;
+	std::atomic<uint64_t> meshedChunks{ 0 };
+	std::atomic<uint64_t> meshTimeNs{ 0 };
+	std::mutex generatedMutex;
+	std::vector<Chunk*> generatedChunks;
+	std::atomic<bool> cancelGeneration{ false };
+	ThreadPool meshThreadPool{ WORKER_COUNT };
 	std::unordered_set<Chunk*> meshEnqueued;
 
+	// Chunks being generated on the pool, by grid position; they join m_chunks once collected
+	std::unordered_map<glm::ivec3, Chunk*> m_chunksLoading;
+
 	void loadChunks(glm::vec3 playerPosition);
+	// Move chunks whose terrain generation finished into the world
+	void collectGeneratedChunks();
+	// Whether the four chunks sharing a border with the grid position are generated
+	bool hasAllNeighbors(const glm::ivec3& chunkPos) const;
 	void unloadChunks(glm::vec3 playerPosition);
 	void generateChunks();
 	void setupChunks();
 	void removeChunks();
+	void sortRenderQueue(const glm::vec3& eye);
 
 	void updateLighting(float deltaTime);
 };
@@ -5,26 +5,27 @@ out vec4 FragColor;
 in vec3 vTexCoord;
 in float vAo;
 
-uniform sampler2DArray uTextureArray;
-uniform bool uColorBlock;
-uniform float uLightIntensity;
+layout(binding = 1) uniform sampler2DArray uTextureArray;
+
+#include "frame_uniforms.glsl"
 
 
 void main()
 {
-	vec4 c = vec4(1.0,1.0,1.0,1.0);
-
-	if (!uColorBlock) {
-		c = texture(uTextureArray, vTexCoord);
+	vec4 c = texture(uTextureArray, vTexCoord);
 
-		c.rgb *= vAo;
-	}
+	c.rgb *= vAo;
 
+#ifndef WIREFRAME
 	// Apply alpha test with a=0.5, 
 	// taking into account the smaller mip levels averaged pixels alpha values
 	if(c.a < 0.5) {
 		discard;
 	}
+#else
+	// Edges of cut-out blocks stay visible as lines
+	c.a = 1.0;
+#endif
 
 	c.rgb *= uLightIntensity;
 
@@ -1,22 +1,35 @@
 #version 450 core
 
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
-layout(location = 2) in vec3 aTexCoord;
-layout(location = 3) in float aAo;
+// Variants (see Renderer::ChunkShaderFeature): AMBIENT_OCCLUSION, WIREFRAME
+
+// Packed chunk vertex (see ChunkVertex)
+// x: x 6 bits | y 7 bits | z 6 bits | face 3 bits | AO level 2 bits
+// y: layer 8 bits | u 7 bits | v 7 bits
+layout(location = 0) in uvec2 aData;
+
+// Chunk origin: per draw with multi-draw-indirect, a constant attribute value for direct draws
+layout(location = 1) in ivec3 aChunkOrigin;
 
 out vec3 vTexCoord;
 out float vAo;
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+#include "frame_uniforms.glsl"
+
+// Same values as m_aoValues
+const float AO_VALUES[4] = float[4](0.2, 0.35, 0.5, 0.8);
 
 void main()
 {
-	vAo = aAo; 
-	vTexCoord = aTexCoord;
-	vec4 viewPos = uView * uModel * vec4(aPos, 1.0);
+	vec3 aPos = vec3(aData.x & 63u, (aData.x >> 6) & 127u, (aData.x >> 13) & 63u);
+	uint ao = (aData.x >> 22) & 3u;
+
+#ifdef AMBIENT_OCCLUSION
+	vAo = AO_VALUES[ao];
+#else
+	vAo = AO_VALUES[3];
+#endif
+	vTexCoord = vec3((aData.y >> 8) & 127u, (aData.y >> 15) & 127u, aData.y & 255u);
+	vec4 viewPos = uView * vec4(aPos + vec3(aChunkOrigin), 1.0);
 
     gl_Position = uProjection * viewPos;
 }
\ No newline at end of file
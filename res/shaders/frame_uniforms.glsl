@@ -0,0 +1,9 @@
+// Per-frame values (see FrameUniformData)
+layout(std140, binding = 0) uniform FrameUniforms {
+	mat4 uView;
+	mat4 uProjection;
+	vec4 uSunDirection;
+	vec4 uHorizonColor;
+	vec4 uZenithColor;
+	float uLightIntensity;
+};
@@ -2,8 +2,8 @@
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+
+#include "frame_uniforms.glsl"
 
 void main() {
     gl_Position = uProjection * uView * uModel * vec4(aPos,1.0);
@@ -6,14 +6,15 @@ layout (location = 2) in vec3 aUV;
 out vec2 vUV;
 out vec3 vWorldDir;
 
-uniform mat4 uProjection;
-uniform mat4 uView;
+#include "frame_uniforms.glsl"
 
 void main()
 {
     vUV = vec2(aUV);
     
-    vec4 viewPos = uView * vec4(aPos, 1.0);
+    // Rotation only, the sky stays centered on the camera
+    mat3 R = mat3(uView);
+    vec4 viewPos = vec4(R * aPos, 1.0);
 
     vec4 pos  = uProjection * viewPos;
     gl_Position = pos;
@@ -22,6 +23,5 @@ void main()
 
     // World-space view direction for the sun
     vec3 dirView  = normalize(viewPos.xyz);
-    mat3 R = mat3(uView); 
     vWorldDir = transpose(R) * dirView; 
 }  
\ No newline at end of file
@@ -29,10 +29,12 @@ Application::~Application()
 	std::cout << "Application shutdown successfully." << std::endl;
 }
 
-void Application::init()
+bool Application::init()
 {
 	renderer = std::make_unique<Renderer>();
-	renderer->init();
+	if (!renderer->init()) {
+		return false;
+	}
 
 	world = new World();
 	world->init();
@@ -47,6 +49,7 @@ void Application::init()
 	glfwSetInputMode(renderer->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
 	initUI();
+	return true;
 }
 
 void Application::run()
@@ -96,7 +99,7 @@ void Application::updateUI()
 	ImGui::NewFrame();
 
 	ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
-	ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiCond_Always);
+	ImGui::SetNextWindowSize(ImVec2(300, 355), ImGuiCond_Always);
 
 	ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoMove |
 		ImGuiWindowFlags_NoResize |
@@ -112,6 +115,24 @@ void Application::updateUI()
 		}
 		const float& lightIntensity = world->getLightIntensity();
 		ImGui::Text("Light Intensity: %.1f",lightIntensity);
+
+		// Meshing throughput of a single worker
+		float meshTimeMs = world->getMeshTimeMs();
+		ImGui::Text("Mesher: %s (F4)", world->useBinaryMesher ? "binary" : "per-cell");
+		ImGui::Text("Meshing: %.2f ms/chunk, %.0f chunks/s", meshTimeMs, meshTimeMs > 0.0f ? 1000.0f / meshTimeMs : 0.0f);
+		ImGui::Text("Generating: %zu chunks", world->getChunksGenerating());
+		ImGui::Text("Chunk triangles: %zu / %zu", renderer->getChunkTriangles(), renderer->getChunkTrianglesTotal());
+		ImGui::Text("Chunks: %zu visible, %d culled", renderer->getChunksVisible(), renderer->getChunksCulled());
+		ImGui::Text("Occlusion: %s, %d hidden (F7)", world->useOcclusionCulling ? "on" : "off", renderer->getChunksOccluded());
+		ImGui::Text("Occlusion wait: %.2f ms", renderer->getOcclusionWaitMs());
+		ImGui::Text("Connectivity: %s, %d unreachable (F8)", world->useConnectivityCulling ? "on" : "off", renderer->getChunksUnreachable());
+		ImGui::Text("Chunk draws: %s, %d calls (F6)", world->useIndirectDraw ? "indirect" : "per chunk", renderer->getChunkDrawCalls());
+
+		// Resident chunk mesh memory, the CPU copy is dropped in GPU-resident mode
+		size_t meshCpuBytes, meshGpuBytes;
+		world->getMeshMemoryUsage(meshCpuBytes, meshGpuBytes);
+		ImGui::Text("Meshes: %s (F5)", world->gpuResidentMeshes ? "GPU-resident" : "CPU copy");
+		ImGui::Text("Mesh memory: CPU %.1f MB, GPU %.1f MB", meshCpuBytes / (1024.0f * 1024.0f), meshGpuBytes / (1024.0f * 1024.0f));
 		//ImGui::Text("Day hour: %.1f", world->hour());
 
 		// Crosshair
@@ -0,0 +1,185 @@
+#include "binary_mesher.h"
+#include "chunk_snapshot.h"
+#include "mesh_data.h"
+#include <bit>
+#include <cstring>
+
+namespace {
+
+	const glm::ivec3 FACE_DIRECTIONS[6] = {
+		{-1, 0, 0},  // 0: left
+		{ 1, 0, 0},  // 1: right
+		{ 0,-1, 0},  // 2: bottom
+		{ 0, 1, 0},  // 3: top
+		{ 0, 0,-1},  // 4: back
+		{ 0, 0, 1}   // 5: front
+	};
+
+	// Bit y of the result is bit y + dy of the column, cells outside the chunk read as empty
+	inline uint64_t shiftY(uint64_t column, int dy) {
+		return dy >= 0 ? column >> dy : column << -dy;
+	}
+
+	inline uint64_t runMask(int start, int length) {
+		return (length >= 64 ? ~uint64_t(0) : ((uint64_t(1) << length) - 1)) << start;
+	}
+}
+
+void BinaryMesher::generate(const ChunkSnapshot& snapshot, MeshData& opaque, MeshData& transparent)
+{
+	for (int face = 0; face < 6; ++face) {
+		processDirection(snapshot, face, opaque, transparent);
+	}
+}
+
+void BinaryMesher::processDirection(const ChunkSnapshot& snapshot, int face, MeshData& opaque, MeshData& transparent)
+{
+	const glm::ivec3& dir = FACE_DIRECTIONS[face];
+	const int axis = face / 2;
+
+	// Heights of the sections being meshed
+	uint64_t sectionBits = 0;
+	for (int s = 0; s < Chunk::SECTION_COUNT; ++s) {
+		if ((snapshot.sectionMask >> s) & 1) {
+			sectionBits |= runMask(s * Chunk::SECTION_HEIGHT, Chunk::SECTION_HEIGHT);
+		}
+	}
+
+	// 1) Visible faces of whole columns: opaque neighbors hide every face, water is also hidden by transparent blocks
+	for (int x = 0; x < SIZE; ++x) {
+		for (int z = 0; z < SIZE; ++z) {
+			uint64_t cells = snapshot.filled[x + 1][z + 1];
+			uint64_t water = snapshot.water[x + 1][z + 1];
+			uint64_t hideOpaque = shiftY(snapshot.opaque[x + 1 + dir.x][z + 1 + dir.z], dir.y);
+			uint64_t hideFilled = shiftY(snapshot.filled[x + 1 + dir.x][z + 1 + dir.z], dir.y);
+			m_visible[x][z] = ((cells & ~water & ~hideOpaque) | (water & ~hideFilled)) & sectionBits;
+		}
+	}
+
+	// 2) Merge keys and bit rows of the visible cells
+	memset(m_rows, 0, sizeof(m_rows));
+	const std::vector<glm::ivec3>& aoOffsets = m_faceAos[face];
+
+	for (int x = 0; x < SIZE; ++x) {
+		for (int z = 0; z < SIZE; ++z) {
+			uint64_t visible = m_visible[x][z];
+			if (!visible) continue;
+
+			// The 8 AO neighbors of every cell of the column, aligned on the cell height
+			uint64_t around[8];
+			for (int k = 0; k < 8; ++k) {
+				const glm::ivec3& o = aoOffsets[k];
+				around[k] = shiftY(snapshot.solid[x + 1 + o.x][z + 1 + o.z], o.y);
+			}
+
+			if (axis == 2) {
+				m_rows[z][x] = visible;
+			}
+
+			while (visible) {
+				int y = std::countr_zero(visible);
+				visible &= visible - 1;
+
+				uint8_t occupancy = 0;
+				for (int k = 0; k < 8; ++k) {
+					occupancy |= ((around[k] >> y) & 1) << k;
+				}
+				m_keys[x][y][z] = uint16_t(uint16_t(snapshot.get(x, y, z)) << 8 | m_aoLevelTable[occupancy]);
+
+				if (axis == 0) m_rows[x][y] |= uint64_t(1) << z;
+				else if (axis == 1) m_rows[y][x] |= uint64_t(1) << z;
+			}
+		}
+	}
+
+	// 3) Greedy merge, slice by slice, without crossing section boundaries. Rows are indexed by u and hold bits along v:
+	// X faces: u = y, v = z, quads grow along v first (width) then u (height)
+	// Y faces: u = x, v = z and Z faces: u = x, v = y, quads grow along u first (width) then v (height)
+	const int sliceCount = axis == 1 ? HEIGHT : SIZE;
+	const int uCount = axis == 0 ? HEIGHT : SIZE;
+	const int vCount = axis == 2 ? HEIGHT : SIZE;
+
+	auto key = [&](int slice, int u, int v) -> uint16_t {
+		if (axis == 0) return m_keys[slice][u][v];
+		if (axis == 1) return m_keys[u][slice][v];
+		return m_keys[u][v][slice];
+	};
+
+	std::vector<Quad> opaqueQuads;
+	std::vector<Quad> transparentQuads;
+
+	for (int slice = 0; slice < sliceCount; ++slice) {
+		uint64_t* rows = m_rows[slice];
+
+		for (int u = 0; u < uCount; ++u) {
+			while (rows[u]) {
+				int v = std::countr_zero(rows[u]);
+				uint16_t k = key(slice, u, v);
+				int width = 1, height = 1;
+
+				if (axis == 0) {
+					const int uEnd = (u / Chunk::SECTION_HEIGHT + 1) * Chunk::SECTION_HEIGHT;
+					while (v + width < vCount && ((rows[u] >> (v + width)) & 1) && key(slice, u, v + width) == k) {
+						width++;
+					}
+					uint64_t run = runMask(v, width);
+					rows[u] &= ~run;
+
+					for (; u + height < uEnd; height++) {
+						uint64_t& row = rows[u + height];
+						bool rowGood = (row & run) == run;
+						for (int w = 0; rowGood && w < width; w++) {
+							rowGood = key(slice, u + height, v + w) == k;
+						}
+						if (!rowGood) break;
+						row &= ~run;
+					}
+				}
+				else {
+					uint64_t bit = uint64_t(1) << v;
+					rows[u] &= ~bit;
+					while (u + width < uCount && (rows[u + width] & bit) && key(slice, u + width, v) == k) {
+						rows[u + width] &= ~bit;
+						width++;
+					}
+
+					const int vEnd = axis == 2 ? (v / Chunk::SECTION_HEIGHT + 1) * Chunk::SECTION_HEIGHT : vCount;
+					for (; v + height < vEnd; height++) {
+						uint64_t next = uint64_t(1) << (v + height);
+						bool rowGood = true;
+						for (int w = 0; rowGood && w < width; w++) {
+							rowGood = (rows[u + w] & next) && key(slice, u + w, v + height) == k;
+						}
+						if (!rowGood) break;
+						for (int w = 0; w < width; w++) {
+							rows[u + w] &= ~next;
+						}
+					}
+				}
+
+				Quad quad;
+				if (axis == 0) quad.position = glm::vec3(slice, u, v);
+				else if (axis == 1) quad.position = glm::vec3(u, slice, v);
+				else quad.position = glm::vec3(u, v, slice);
+				quad.size = glm::vec2(width, height);
+				quad.direction = dir;
+				quad.type = BlockType(k >> 8);
+				quad.ao = uint8_t(k);
+
+				if (quad.type == BlockType::Water) {
+					transparentQuads.push_back(quad);
+				}
+				else {
+					opaqueQuads.push_back(quad);
+				}
+			}
+		}
+	}
+
+	for (const auto& quad : opaqueQuads) {
+		Chunk::generateQuadGeometry(quad, opaque);
+	}
+	for (const auto& quad : transparentQuads) {
+		Chunk::generateQuadGeometry(quad, transparent);
+	}
+}
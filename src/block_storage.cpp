@@ -0,0 +1,105 @@
+#include "block_storage.h"
+
+BlockStorage::BlockStorage(size_t size, BlockType fillType)
+	: m_size(size)
+{
+	fill(fillType);
+}
+
+void BlockStorage::set(size_t index, BlockType type)
+{
+	BlockType previous = get(index);
+	if (previous == type) {
+		return;
+	}
+
+	if (--m_typeCounts[size_t(previous)] == 0) {
+		--m_distinctTypes;
+	}
+	if (m_typeCounts[size_t(type)]++ == 0) {
+		++m_distinctTypes;
+	}
+
+	// The last differing cell was overwritten, drop the packed indices entirely
+	if (m_distinctTypes == 1) {
+		fill(type);
+		return;
+	}
+
+	uint8_t paletteIndex = m_paletteIndex[size_t(type)];
+	if (paletteIndex == NO_INDEX) {
+		paletteIndex = addToPalette(type);
+	}
+
+	uint64_t& word = m_data[index >> m_wordShift];
+	uint64_t shift = (index & m_slotMask) << m_bitsShift;
+	word = (word & ~(m_valueMask << shift)) | (uint64_t(paletteIndex) << shift);
+}
+
+void BlockStorage::fill(BlockType type)
+{
+	m_palette.assign(1, type);
+	m_paletteIndex.fill(NO_INDEX);
+	m_paletteIndex[size_t(type)] = 0;
+
+	m_typeCounts.fill(0);
+	m_typeCounts[size_t(type)] = static_cast<uint32_t>(m_size);
+	m_distinctTypes = 1;
+
+	m_data.clear();
+	resize(0);
+}
+
+size_t BlockStorage::getMemoryUsage() const
+{
+	return m_palette.capacity() * sizeof(BlockType) + m_data.capacity() * sizeof(uint64_t);
+}
+
+void BlockStorage::resize(uint64_t bitsPerEntry)
+{
+	uint64_t bitsShift = 0, wordShift, slotMask, valueMask;
+	if (bitsPerEntry == 0) {
+		// Uniform: every index resolves to word 0, slot 0, palette entry 0
+		wordShift = 63;
+		slotMask = 0;
+		valueMask = 0;
+	}
+	else {
+		while ((uint64_t(1) << bitsShift) < bitsPerEntry) {
+			++bitsShift;
+		}
+		wordShift = 6 - bitsShift;
+		slotMask = (uint64_t(1) << wordShift) - 1;
+		valueMask = (uint64_t(1) << bitsPerEntry) - 1;
+	}
+
+	size_t wordCount = bitsPerEntry == 0 ? 1 : (m_size + slotMask) >> wordShift;
+	std::vector<uint64_t> data(wordCount, 0);
+
+	// Repack the existing indices at the new width
+	if (!m_data.empty()) {
+		for (size_t i = 0; i < m_size; ++i) {
+			uint64_t value = (m_data[i >> m_wordShift] >> ((i & m_slotMask) << m_bitsShift)) & m_valueMask;
+			data[i >> wordShift] |= value << ((i & slotMask) << bitsShift);
+		}
+	}
+
+	m_data = std::move(data);
+	m_bitsShift = bitsShift;
+	m_wordShift = wordShift;
+	m_slotMask = slotMask;
+	m_valueMask = valueMask;
+}
+
+uint8_t BlockStorage::addToPalette(BlockType type)
+{
+	uint8_t paletteIndex = static_cast<uint8_t>(m_palette.size());
+	m_palette.push_back(type);
+	m_paletteIndex[size_t(type)] = paletteIndex;
+
+	// Grow 0 -> 1 -> 2 -> 4 -> 8 bits per entry once the palette no longer fits
+	if (m_palette.size() > m_valueMask + 1) {
+		resize(getBitsPerEntry() == 0 ? 1 : getBitsPerEntry() * 2);
+	}
+	return paletteIndex;
+}
@@ -1,40 +1,43 @@
 ﻿#include "chunk.h"
 #include <iostream> 
-#define FNL_IMPL
-#include "FastNoiseLite.h"
 #include "glad/glad.h" 
 #include <GLFW/glfw3.h>
 #include "world.h"
+#include "binary_mesher.h"
+#include "chunk_snapshot.h"
+#include "mesh_scratch.h"
+#include "mesh_data.h"
+#include <bit>
+#include <algorithm>
 
 Chunk::Chunk(int x, int y, int z, World* world)
-	: m_indexCount(0)
+	: m_sections(SECTION_COUNT, BlockStorage(size_t(CHUNK_SIZE) * SECTION_HEIGHT * CHUNK_SIZE))
 {
 	m_x = x * CHUNK_SIZE;
 	m_y = y * CHUNK_HEIGHT;
 	m_z = z * CHUNK_SIZE;
 	m_world = world;
+
+	memset(m_opaqueMask, 0, sizeof(m_opaqueMask));
+	memset(m_transparentMask, 0, sizeof(m_transparentMask));
+	memset(m_waterMask, 0, sizeof(m_waterMask));
 }
 
 Chunk::Chunk(const Chunk* chunk)
+	: m_sections(chunk->m_sections)
 {
+	memcpy(m_opaqueMask, chunk->m_opaqueMask, sizeof(m_opaqueMask));
+	memcpy(m_transparentMask, chunk->m_transparentMask, sizeof(m_transparentMask));
+	memcpy(m_waterMask, chunk->m_waterMask, sizeof(m_waterMask));
 	m_x = chunk->m_x;
 	m_y = chunk->m_y;
 	m_z = chunk->m_z;
 	//m_chunkManager = chunk->m_chunkManager;
-	for (int x = 0; x < CHUNK_SIZE; ++x) {
-		for (int y = 0; y < CHUNK_HEIGHT; ++y) {
-			for (int z = 0; z < CHUNK_SIZE; ++z) {
-				cubes[x][y][z] = chunk->cubes[x][y][z];
-			}
-		}
-	}
 	m_world = chunk->m_world;
-	m_mesh = std::make_unique<Mesh>(*chunk->m_mesh);
 }
 
 Chunk::~Chunk()
 {
-	memset(m_visited, false, sizeof(m_visited));
 }
 
 void Chunk::setBlockType(int x, int y, int z, BlockType type)
@@ -42,7 +45,7 @@ void Chunk::setBlockType(int x, int y, int z, BlockType type)
 	if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE) {
 		return;
 	}
-	cubes[x][y][z] = type;
+	setBlock(x, y, z, type);
 }
 
 BlockType Chunk::getBlockType(int x, int y, int z) const
@@ -50,7 +53,7 @@ BlockType Chunk::getBlockType(int x, int y, int z) const
     if (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE) {
         return BlockType::None;
     }
-    return cubes[x][y][z];
+    return getBlock(x, y, z);
 }
 
 BlockType Chunk::getBlockType(glm::ivec3 pos) const
@@ -58,7 +61,16 @@ BlockType Chunk::getBlockType(glm::ivec3 pos) const
 	if (pos.x < 0 || pos.x >= CHUNK_SIZE || pos.y < 0 || pos.y >= CHUNK_HEIGHT || pos.z < 0 || pos.z >= CHUNK_SIZE) {
 		return BlockType::None;
 	}
-	return cubes[pos.x][pos.y][pos.z];
+	return getBlock(pos.x, pos.y, pos.z);
+}
+
+size_t Chunk::getBlockMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (const BlockStorage& section : m_sections) {
+		bytes += section.getMemoryUsage();
+	}
+	return bytes;
 }
 
 BlockType Chunk::getBlockTypeWorldPos(int worldX, int worldY, int worldZ) const
@@ -81,74 +93,16 @@ BlockType Chunk::getBlockTypeWorldPos(glm::ivec3 worldPos) const
     return getBlockType(localX, localY, localZ);
 }
 
-void Chunk::load()
+void Chunk::generateMeshData(const ChunkSnapshot& snapshot, MeshScratch& scratch, MeshData& opaque, MeshData& transparent) const
 {
-    m_indexCount = 0;
-    BlockType type = BlockType::None;
-    fnl_state& noise = m_world->noise;
-    noise.noise_type = FNL_NOISE_PERLIN;
-    noise.frequency = 0.015f;
-
-    for (int x = 0; x < CHUNK_SIZE; ++x) {
-        for (int z = 0; z < CHUNK_SIZE; ++z) {
-            // Generate a height for the current (x, z) position based on noise
-            float noiseValue = fnlGetNoise2D(&noise, m_x + x, m_z + z);
-            int maxHeight = static_cast<int>((noiseValue + 1.0f) * (CHUNK_HEIGHT / 2));
-
-            for (int y = 0; y < CHUNK_HEIGHT; ++y) {
-                type = BlockType::None;
-                if (y < maxHeight) {
-                    if (y < maxHeight - 4) {
-                        type = BlockType::Stone;
-                    }
-                    else if (y == maxHeight - 1) {
-
-						if (maxHeight <= WATER_HEIGHT) {
-							type = BlockType::Sand;
-						}
-						else {
-							type = BlockType::Grass;
-						}
-
-					}
-                    else {
-                        type = BlockType::Dirt;
-                    }
-                }
-                cubes[x][y][z] = type;
-
-                // Add water blocks if maxHeight is below WATER_HEIGHT
-                if (maxHeight < WATER_HEIGHT) {
-                    for (int y = maxHeight; y < WATER_HEIGHT; y++) {
-                        if (cubes[x][y][z] == BlockType::None) {
-                            cubes[x][y][z] = BlockType::Water;
-                        }
-                    }
-                }
-            }
-        }
-    }
-
+    opaque.sectionMask = snapshot.sectionMask;
+    transparent.sectionMask = snapshot.sectionMask;
 
-	fnl_state treeNoise = fnlCreateState();
-	treeNoise.noise_type = FNL_NOISE_OPENSIMPLEX2S; 
-    treeNoise.frequency = 0.5f;    
-    for (int x = 2; x < CHUNK_SIZE - 2; ++x) {
-        for (int z = 2; z < CHUNK_SIZE - 2; ++z) {
-            float tn = fnlGetNoise2D(&treeNoise, m_x + x, m_z + z);
-            if (tn > 0.8f && cubes[x][getSurfaceY(x, z)][z] == BlockType::Grass) {
-                int baseY = getSurfaceY(x, z) + 1;
-                plantTree(x, baseY, z);
-            }
-        }
+    if (snapshot.binaryMesher) {
+        scratch.binaryMesher.generate(snapshot, opaque, transparent);
+        return;
     }
-	
-}
 
-void Chunk::generateMeshData()
-{
-    m_mesh = std::make_unique<Mesh>();
-    m_transparentMesh = std::make_unique<Mesh>();
     // All 6 directions
     std::vector<glm::ivec3> directions = {
         {-1, 0, 0},  // 0: left   
@@ -161,33 +115,103 @@ void Chunk::generateMeshData()
 
     // Process each direction separately
     for (const glm::ivec3& dir : directions) {
-        processDirection(dir);
+        processDirection(snapshot, scratch, dir, opaque, transparent);
     }
 }
 
-void Chunk::swapMeshes()
+void Chunk::uploadMesh(std::unique_ptr<MeshData>& opaque, std::unique_ptr<MeshData>& transparent, bool keepCpuData)
 {
-	// Swap the active mesh with the generated mesh
-    m_activeMesh = std::make_unique<Mesh>(m_mesh.get());
-    m_activeTransparentMesh = std::make_unique<Mesh>(m_transparentMesh.get());
+    if (!m_mesh) {
+        m_mesh = std::make_unique<ChunkMesh>(m_world->getMeshArena());
+        m_transparentMesh = std::make_unique<ChunkMesh>(m_world->getMeshArena());
+    }
+    m_mesh->upload(opaque, keepCpuData);
+    m_transparentMesh->upload(transparent, keepCpuData);
+    updateHeightBounds();
 }
 
-void Chunk::processDirection(const glm::ivec3& dir)
+void Chunk::updateHeightBounds()
+{
+    int minHeight = CHUNK_HEIGHT;
+    int maxHeight = 0;
+    for (int tx = 0; tx < OCCLUDER_TILES; ++tx) {
+        for (int tz = 0; tz < OCCLUDER_TILES; ++tz) {
+            // Lowest run of opaque cells starting at y = 0 among the tile columns
+            int solidHeight = CHUNK_HEIGHT;
+            for (int x = tx * OCCLUDER_TILE_SIZE; x < (tx + 1) * OCCLUDER_TILE_SIZE; ++x) {
+                for (int z = tz * OCCLUDER_TILE_SIZE; z < (tz + 1) * OCCLUDER_TILE_SIZE; ++z) {
+                    uint64_t column = getFilledColumn(x, z);
+                    if (column) {
+                        minHeight = std::min(minHeight, std::countr_zero(column));
+                        maxHeight = std::max(maxHeight, CHUNK_HEIGHT - std::countl_zero(column));
+                    }
+                    solidHeight = std::min(solidHeight, std::countr_one(getOpaqueColumn(x, z)));
+                }
+            }
+            m_occluderHeights[tx][tz] = uint8_t(solidHeight);
+        }
+    }
+    m_minHeight = maxHeight > 0 ? minHeight : 0;
+    m_maxHeight = maxHeight;
+}
+
+size_t Chunk::getMeshCpuMemoryUsage() const
+{
+    return m_mesh ? m_mesh->getCpuMemoryUsage() + m_transparentMesh->getCpuMemoryUsage() : 0;
+}
+
+size_t Chunk::getMeshGpuMemoryUsage() const
+{
+    return m_mesh ? m_mesh->getGpuMemoryUsage() + m_transparentMesh->getGpuMemoryUsage() : 0;
+}
+
+uint8_t Chunk::takeDirtySections()
+{
+    uint8_t sections = m_mesh ? m_dirtySections : ALL_SECTIONS;
+    m_dirtySections = 0;
+    return sections;
+}
+
+void Chunk::processDirection(const ChunkSnapshot& snapshot, MeshScratch& scratch, const glm::ivec3& dir, MeshData& opaque, MeshData& transparent) const
 {
     // Determine which axes to expand based on direction
     glm::ivec3 widthAxis, heightAxis;
     getExpansionAxes(dir, widthAxis, heightAxis);
 
-    memset(m_visited, false, sizeof(m_visited));
+    memset(scratch.visited, false, sizeof(scratch.visited));
+    memset(scratch.visibility, false, sizeof(scratch.visibility));
 
-    // 1) Pre‑compute visibility & AO for every cell
-    for (int x = 0; x < CHUNK_SIZE; ++x) {
-        for (int y = 0; y < CHUNK_HEIGHT; ++y) {
-            for (int z = 0; z < CHUNK_SIZE; ++z) {
-                bool vis = isBlockFaceVisible(x, y, z, dir, cubes[x][y][z]);
-                m_visibilityCache[x][y][z] = vis;
-                if (vis) {
-                    m_aoCache[x][y][z] = getAmbientOcclusion({ x,y,z }, dir);
+    // 1) Pre‑compute visibility & AO, section by section
+    bool sectionHasFaces[SECTION_COUNT] = {};
+    for (int s = 0; s < SECTION_COUNT; ++s) {
+        bool uniform = snapshot.sectionUniform[s];
+        BlockType uniformType = snapshot.sectionType[s];
+
+        // Sections not being remeshed and empty sections are skipped
+        if (!((snapshot.sectionMask >> s) & 1) || (uniform && uniformType == BlockType::None)) {
+            continue;
+        }
+
+        int xBegin = 0, xEnd = CHUNK_SIZE;
+        int yBegin = s * SECTION_HEIGHT, yEnd = yBegin + SECTION_HEIGHT;
+        int zBegin = 0, zEnd = CHUNK_SIZE;
+
+        // In a uniform section whose block hides its own faces, only the layer facing dir can be visible
+        if (uniform && !isFaceVisibleAgainst(uniformType, uniformType)) {
+            if (dir.x != 0) { xBegin = dir.x > 0 ? CHUNK_SIZE - 1 : 0; xEnd = xBegin + 1; }
+            if (dir.y != 0) { yBegin = dir.y > 0 ? yEnd - 1 : yBegin; yEnd = yBegin + 1; }
+            if (dir.z != 0) { zBegin = dir.z > 0 ? CHUNK_SIZE - 1 : 0; zEnd = zBegin + 1; }
+        }
+
+        for (int x = xBegin; x < xEnd; ++x) {
+            for (int y = yBegin; y < yEnd; ++y) {
+                for (int z = zBegin; z < zEnd; ++z) {
+                    bool vis = isBlockFaceVisible(snapshot, x, y, z, dir, snapshot.get(x, y, z));
+                    scratch.visibility[x][y][z] = vis;
+                    if (vis) {
+                        scratch.ao[x][y][z] = getAmbientOcclusion(snapshot, { x,y,z }, dir);
+                        sectionHasFaces[s] = true;
+                    }
                 }
             }
         }
@@ -198,18 +222,22 @@ void Chunk::processDirection(const glm::ivec3& dir)
 
     for (int x = 0; x < CHUNK_SIZE; ++x) {
         for (int y = 0; y < CHUNK_HEIGHT; ++y) {
+            // Skip to the next section when this one has nothing visible
+            if (!sectionHasFaces[y / SECTION_HEIGHT]) {
+                y += SECTION_HEIGHT - 1;
+                continue;
+            }
             for (int z = 0; z < CHUNK_SIZE; ++z) {
                 glm::ivec3 currentPos(x, y, z);
-				glm::ivec3 worldPos = currentPos + glm::ivec3(m_x, m_y, m_z);
-                BlockType blockType = cubes[x][y][z];
+                BlockType blockType = snapshot.get(x, y, z);
 
-                if (m_visited[x][y][z] || !m_visibilityCache[x][y][z]) {
+                if (scratch.visited[x][y][z] || !scratch.visibility[x][y][z]) {
                     continue;
                 }
 
-                m_visited[x][y][z] = true;
-				std::array<float, 4>& ao = m_aoCache[x][y][z];
-                auto [width, height] = expandQuad(currentPos, dir, blockType, widthAxis, heightAxis, ao);
+                scratch.visited[x][y][z] = true;
+				uint8_t ao = scratch.ao[x][y][z];
+                auto [width, height] = expandQuad(snapshot, scratch, currentPos, dir, blockType, widthAxis, heightAxis, ao);
 
 				Quad quad;
 				quad.position = currentPos;
@@ -231,15 +259,15 @@ void Chunk::processDirection(const glm::ivec3& dir)
 
     // Generate mesh from quads for this direction
     for (const auto& quad : opaqueQuads) {
-        generateQuadGeometry(quad, m_mesh->vertices, m_mesh->normals, m_mesh->texCoords, m_mesh->ao, m_mesh->indices);
+        generateQuadGeometry(quad, opaque);
     }
 	for (const auto& quad : transparentQuads) {
-		generateQuadGeometry(quad, m_transparentMesh->vertices, m_transparentMesh->normals, m_transparentMesh->texCoords, m_transparentMesh->ao, m_transparentMesh->indices);
+		generateQuadGeometry(quad, transparent);
 	}
 }
 
-std::pair<int, int> Chunk::expandQuad(const glm::ivec3& startPos, const glm::vec3& dir,
-	BlockType blockType, const glm::ivec3& widthAxis, const glm::ivec3& heightAxis, std::array<float, 4>& ao)
+std::pair<int, int> Chunk::expandQuad(const ChunkSnapshot& snapshot, MeshScratch& scratch, const glm::ivec3& startPos, const glm::vec3& dir,
+	BlockType blockType, const glm::ivec3& widthAxis, const glm::ivec3& heightAxis, uint8_t ao)
 {
     int width = 1, height = 1;
 
@@ -247,18 +275,15 @@ std::pair<int, int> Chunk::expandQuad(const glm::ivec3& startPos, const glm::vec
     while (true) {
         glm::ivec3 nextPos = startPos + widthAxis * width;
 
-		nextAo = m_aoCache[nextPos.x][nextPos.y][nextPos.z];
-		bool visible = m_visibilityCache[nextPos.x][nextPos.y][nextPos.z];
-
         if (!isValidPosition(nextPos) ||
-            m_visited[nextPos.x][nextPos.y][nextPos.z] ||
-            cubes[nextPos.x][nextPos.y][nextPos.z] != blockType ||
-            !visible ||
-            ao!=nextAo) {
+            scratch.visited[nextPos.x][nextPos.y][nextPos.z] ||
+            snapshot.get(nextPos.x, nextPos.y, nextPos.z) != blockType ||
+            !scratch.visibility[nextPos.x][nextPos.y][nextPos.z] ||
+            ao != scratch.ao[nextPos.x][nextPos.y][nextPos.z]) {
             break;
         }
 
-		m_visited[nextPos.x][nextPos.y][nextPos.z] = true; // Mark as visited
+		scratch.visited[nextPos.x][nextPos.y][nextPos.z] = true; // Mark as visited
         width++;
     }
 
@@ -270,14 +295,11 @@ std::pair<int, int> Chunk::expandQuad(const glm::ivec3& startPos, const glm::vec
         for (int w = 0; w < width; w++) {
             glm::ivec3 checkPos = startPos + widthAxis * w + heightAxis * h;
 
-			nextAo = m_aoCache[checkPos.x][checkPos.y][checkPos.z];
-			bool visible = m_visibilityCache[checkPos.x][checkPos.y][checkPos.z];
-
             if (!isValidPosition(checkPos) ||
-                m_visited[checkPos.x][checkPos.y][checkPos.z] ||
-                cubes[checkPos.x][checkPos.y][checkPos.z] != blockType ||
-                !visible ||
-                nextAo != ao) {
+                scratch.visited[checkPos.x][checkPos.y][checkPos.z] ||
+                snapshot.get(checkPos.x, checkPos.y, checkPos.z) != blockType ||
+                !scratch.visibility[checkPos.x][checkPos.y][checkPos.z] ||
+                scratch.ao[checkPos.x][checkPos.y][checkPos.z] != ao) {
                 rowGood = false;
                 break;
             }
@@ -288,7 +310,7 @@ std::pair<int, int> Chunk::expandQuad(const glm::ivec3& startPos, const glm::vec
             // Mark entire row as visited
             for (int w = 0; w < width; w++) {
                 glm::ivec3 markPos = startPos + widthAxis * w + heightAxis * h;
-				m_visited[markPos.x][markPos.y][markPos.z] = true; // Mark as visited
+				scratch.visited[markPos.x][markPos.y][markPos.z] = true; // Mark as visited
             }
         }
         else {
@@ -328,288 +350,155 @@ bool Chunk::isValidPosition(const glm::ivec3& pos)
 int Chunk::getMaxHeight(const glm::ivec3& startPos, const glm::ivec3& heightAxis)
 {
     if (heightAxis.x != 0) return CHUNK_SIZE - startPos.x;
-    if (heightAxis.y != 0) return CHUNK_HEIGHT - startPos.y;
+    if (heightAxis.y != 0) return (startPos.y / SECTION_HEIGHT + 1) * SECTION_HEIGHT - startPos.y; // Quads stay within their section
     if (heightAxis.z != 0) return CHUNK_SIZE - startPos.z;
     return 0;
 }
 
-void Chunk::generateQuadGeometry(const Quad& quad, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec3>& textures,
-    std::vector<float>& ao, std::vector<unsigned int>& indices)
+void Chunk::generateQuadGeometry(const Quad& quad, MeshData& mesh)
 {
-    glm::vec3 pos = quad.position;
-    float width = quad.size.x;
-    float height = quad.size.y;
-    glm::vec3 dir = quad.direction;
+    int x = int(quad.position.x), y = int(quad.position.y), z = int(quad.position.z);
+    int width = int(quad.size.x);
+    int height = int(quad.size.y);
 
     // Convert direction to face index
-    int faceIndex = Atlas::faceIndexForDir(dir);
+    int faceIndex = Atlas::faceIndexForDir(quad.direction);
 
-    glm::vec3 v1, v2, v3, v4;
-    float x = pos.x, y = pos.y, z = pos.z;
+    glm::ivec3 v1, v2, v3, v4;
 
 	// Vertex positions 
     switch (faceIndex) {
     case 0: // Left face (-X)
-        v1 = glm::vec3(x, y, z);             // bottom-left
-        v2 = glm::vec3(x, y, z + width);     // bottom-right  
-        v3 = glm::vec3(x, y + height, z);    // top-left
-        v4 = glm::vec3(x, y + height, z + width); // top-right
+        v1 = glm::ivec3(x, y, z);             // bottom-left
+        v2 = glm::ivec3(x, y, z + width);     // bottom-right  
+        v3 = glm::ivec3(x, y + height, z);    // top-left
+        v4 = glm::ivec3(x, y + height, z + width); // top-right
         break;
     case 1: // Right face (+X)
-        v1 = glm::vec3(x + 1, y, z + width); // bottom-left
-        v2 = glm::vec3(x + 1, y, z);         // bottom-right
-        v3 = glm::vec3(x + 1, y + height, z + width); // top-left
-        v4 = glm::vec3(x + 1, y + height, z); // top-right
+        v1 = glm::ivec3(x + 1, y, z + width); // bottom-left
+        v2 = glm::ivec3(x + 1, y, z);         // bottom-right
+        v3 = glm::ivec3(x + 1, y + height, z + width); // top-left
+        v4 = glm::ivec3(x + 1, y + height, z); // top-right
         break;
     case 2: // Bottom face (-Y)
-        v1 = glm::vec3(x, y, z);             // bottom-left
-        v2 = glm::vec3(x + width, y, z);     // bottom-right
-        v3 = glm::vec3(x, y, z + height);    // top-left
-        v4 = glm::vec3(x + width, y, z + height); // top-right
+        v1 = glm::ivec3(x, y, z);             // bottom-left
+        v2 = glm::ivec3(x + width, y, z);     // bottom-right
+        v3 = glm::ivec3(x, y, z + height);    // top-left
+        v4 = glm::ivec3(x + width, y, z + height); // top-right
         break;
     case 3: // Top face (+Y)
-        v1 = glm::vec3(x, y + 1, z + height); // bottom-left
-        v2 = glm::vec3(x + width, y + 1, z + height); // bottom-right
-        v3 = glm::vec3(x, y + 1, z);         // top-left
-        v4 = glm::vec3(x + width, y + 1, z); // top-right
+        v1 = glm::ivec3(x, y + 1, z + height); // bottom-left
+        v2 = glm::ivec3(x + width, y + 1, z + height); // bottom-right
+        v3 = glm::ivec3(x, y + 1, z);         // top-left
+        v4 = glm::ivec3(x + width, y + 1, z); // top-right
         break;
     case 4: // Back face (-Z)
-        v1 = glm::vec3(x + width, y, z);     // bottom-left
-        v2 = glm::vec3(x, y, z);             // bottom-right
-        v3 = glm::vec3(x + width, y + height, z); // top-left
-        v4 = glm::vec3(x, y + height, z);    // top-right
+        v1 = glm::ivec3(x + width, y, z);     // bottom-left
+        v2 = glm::ivec3(x, y, z);             // bottom-right
+        v3 = glm::ivec3(x + width, y + height, z); // top-left
+        v4 = glm::ivec3(x, y + height, z);    // top-right
         break;
-    case 5: // Front face (+Z)
-        v1 = glm::vec3(x, y, z + 1);         // bottom-left
-        v2 = glm::vec3(x + width, y, z + 1); // bottom-right
-        v3 = glm::vec3(x, y + height, z + 1); // top-left
-        v4 = glm::vec3(x + width, y + height, z + 1); // top-right
+    default: // Front face (+Z)
+        v1 = glm::ivec3(x, y, z + 1);         // bottom-left
+        v2 = glm::ivec3(x + width, y, z + 1); // bottom-right
+        v3 = glm::ivec3(x, y + height, z + 1); // top-left
+        v4 = glm::ivec3(x + width, y + height, z + 1); // top-right
         break;
     }
 
-    // Add vertices
-    size_t startIndex = vertices.size();
-    vertices.push_back(v1);
-    vertices.push_back(v2);
-    vertices.push_back(v3);
-    vertices.push_back(v4);
-
-    // Add normals
-    for (int i = 0; i < 4; ++i) {
-        normals.push_back(dir);
-    }
-
-    // Add texture coordinates
     int layer = Atlas::getLayer(quad.type, quad.direction);
 
-	// UV mapping
-    glm::vec3 uv1 = glm::vec3(0.0f, 0.0f, layer);        // bottom-left
-    glm::vec3 uv2 = glm::vec3(width, 0.0f, layer);       // bottom-right
-    glm::vec3 uv3 = glm::vec3(0.0f, height, layer);      // top-left
-    glm::vec3 uv4 = glm::vec3(width, height, layer);     // top-right
-
-    textures.push_back(uv1);
-    textures.push_back(uv2);
-    textures.push_back(uv3);
-    textures.push_back(uv4);
-
-
-	// Add ambient occlusion values
-    if (m_world->useAmbientOcclusion)
-    {
-	    ao.push_back(quad.ao[0]);
-	    ao.push_back(quad.ao[1]);
-	    ao.push_back(quad.ao[2]);
-	    ao.push_back(quad.ao[3]);
-
-        float diagA = quad.ao[0] + quad.ao[3];
-        float diagB = quad.ao[1] + quad.ao[2];
-        bool flip = diagA > diagB;
-
-        if (!flip) 
-        {
-            indices.push_back(startIndex);     // v1
-            indices.push_back(startIndex + 1); // v2
-            indices.push_back(startIndex + 2); // v3
-            indices.push_back(startIndex + 2); // v3
-            indices.push_back(startIndex + 1); // v2
-            indices.push_back(startIndex + 3); // v4
-        }
-        else 
-        {
-            indices.push_back(startIndex);     // v1
-            indices.push_back(startIndex + 1); // v2
-            indices.push_back(startIndex + 3); // v4
-            indices.push_back(startIndex);     // v1
-            indices.push_back(startIndex + 3); // v4
-            indices.push_back(startIndex + 2); // v3
-        }
-    }
-    else
-    {
-        indices.push_back(startIndex);     // v1
-        indices.push_back(startIndex + 1); // v2
-        indices.push_back(startIndex + 2); // v3
-        indices.push_back(startIndex + 2); // v3
-        indices.push_back(startIndex + 1); // v2
-        indices.push_back(startIndex + 3); // v4
-    }
-}
-
-int Chunk::getSurfaceY(int x, int z) const
-{
-    for (int y = CHUNK_HEIGHT - 1; y >= 0; --y) {
-        if (cubes[x][y][z] != BlockType::None) return y;
-    }
-    return 0;
+    // AO levels are always baked, the chunk program variant decides whether they shade
+    uint8_t ao = quad.ao;
+    bool flip = m_aoFlipTable[ao];
+
+    // UV mapping spans the whole greedy quad so the texture repeats per block
+    mesh.addQuad(y / SECTION_HEIGHT,
+        ChunkVertex::pack(v1.x, v1.y, v1.z, faceIndex, ao & 3, layer, 0, 0),
+        ChunkVertex::pack(v2.x, v2.y, v2.z, faceIndex, (ao >> 2) & 3, layer, width, 0),
+        ChunkVertex::pack(v3.x, v3.y, v3.z, faceIndex, (ao >> 4) & 3, layer, 0, height),
+        ChunkVertex::pack(v4.x, v4.y, v4.z, faceIndex, (ao >> 6) & 3, layer, width, height),
+        flip);
 }
 
-void Chunk::plantTree(int x, int y, int z)
+bool Chunk::isBlockFaceVisible(const ChunkSnapshot& snapshot, int x, int y, int z, const glm::ivec3& dir, BlockType faceType)
 {
-	// Trunk
-	for (int i = 0; i < 3; ++i) {
-		if (y + i < CHUNK_HEIGHT) {
-			cubes[x][y + i][z] = BlockType::Tree;
-		}
-	}
+    if (faceType == BlockType::None) return false;
 
-    // Leaves
-    int leafStartY = y + 2;
-    int leafLayers = 2;
-    int baseRadius = 2;  
-
-    for (int i = 0; i < leafLayers; ++i) {
-        int dy = leafStartY + i;
-
-        int radius = baseRadius - i;
-        if (radius < 0) radius = 0;
-
-        for (int dx = -radius; dx <= radius; ++dx) {
-            for (int dz = -radius; dz <= radius; ++dz) {
-                if (dx * dx + dz * dz <= radius * radius) {
-                    int nx = x + dx;
-                    int nz = z + dz;
-                    if (nx >= 0 && nx < CHUNK_SIZE
-                        && nz >= 0 && nz < CHUNK_SIZE
-                        && dy < CHUNK_HEIGHT)
-                    {
-                        if (cubes[nx][dy][nz] != BlockType::Tree) {
-                            cubes[nx][dy][nz] = BlockType::Leaves;
-                        }
-                    }
-                }
-            }
-        }
-    }
+	int nx = x + dir.x + 1;
+	int ny = y + dir.y;
+	int nz = z + dir.z + 1;
+	if (ny < 0 || ny >= CHUNK_HEIGHT) return true;
 
+	// Opaque neighbors hide every face, water is also hidden by transparent blocks
+	uint64_t hiding = faceType == BlockType::Water ? snapshot.filled[nx][nz] : snapshot.opaque[nx][nz];
+	return ((hiding >> ny) & 1) == 0;
 }
 
-BlockType Chunk::getNeighborType(const glm::ivec3& pos, const glm::ivec3& dir) const
+uint8_t Chunk::getVisibleFaces(const glm::vec3& eye) const
 {
-    BlockType type = BlockType::None;
-    int nx = pos.x + dir.x;
-    int ny = pos.y + dir.y;
-    int nz = pos.z + dir.z;
-
-    // if neighbor is out of chunk
-    if (nx < 0 || nx >= CHUNK_SIZE ||
-        ny < 0 || ny >= CHUNK_HEIGHT ||
-        nz < 0 || nz >= CHUNK_SIZE)
-    {
-        // Neighbor is outside this chunk - check adjacent chunk
-        Chunk* neighbor = nullptr;
-        glm::ivec3 neighborPos = glm::ivec3(nx, ny, nz);
-        glm::ivec3 neighborDelta = glm::ivec3(0, 0, 0);
-
-        if (nx < 0) {
-            neighborDelta.x = -CHUNK_SIZE;
-            neighborPos.x = nx + CHUNK_SIZE; // This will be CHUNK_SIZE-1 when nx=-1
-        }
-        else if (nx >= CHUNK_SIZE) {
-            neighborDelta.x = CHUNK_SIZE;
-            neighborPos.x = nx - CHUNK_SIZE; // This will be 0 when nx=CHUNK_SIZE
-        }
-
-        if (ny < 0) {
-            neighborDelta.y = -CHUNK_HEIGHT;
-            neighborPos.y = ny + CHUNK_HEIGHT;
-        }
-        else if (ny >= CHUNK_HEIGHT) {
-            neighborDelta.y = CHUNK_HEIGHT;
-            neighborPos.y = ny - CHUNK_HEIGHT;
-        }
-
-        if (nz < 0) {
-            neighborDelta.z = -CHUNK_SIZE;
-            neighborPos.z = nz + CHUNK_SIZE;
-        }
-        else if (nz >= CHUNK_SIZE) {
-            neighborDelta.z = CHUNK_SIZE;
-            neighborPos.z = nz - CHUNK_SIZE;
-        }
-
-        neighbor = m_world->getChunk(m_x + neighborDelta.x, m_y + neighborDelta.y, m_z + neighborDelta.z);
-        if (neighbor) {
-            type = neighbor->cubes[neighborPos.x][neighborPos.y][neighborPos.z];
-        }
-        else {
-            type = BlockType::None;
-        }
-    }
-    else {
-        // Neighbor is within this chunk
-        type = cubes[nx][ny][nz];
-    }
-    return type;
+    glm::vec3 min = getWorldPosition();
+    glm::vec3 max = min + glm::vec3(CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE);
+
+    // A face is front-facing only when the eye is on the side its normal points to
+    uint8_t mask = 0;
+    if (eye.x < max.x) mask |= 1 << 0; // left
+    if (eye.x > min.x) mask |= 1 << 1; // right
+    if (eye.y < max.y) mask |= 1 << 2; // bottom
+    if (eye.y > min.y) mask |= 1 << 3; // top
+    if (eye.z < max.z) mask |= 1 << 4; // back
+    if (eye.z > min.z) mask |= 1 << 5; // front
+    return mask;
 }
 
-inline bool Chunk::isBlockFaceVisible(int x, int y, int z, const glm::ivec3& dir, BlockType faceType) const
+size_t Chunk::getQuadCount() const
 {
-    if (faceType == BlockType::None) return false;
-
-	BlockType neighborBlockType = getNeighborType(glm::ivec3(x, y, z), dir);
-	if (faceType == BlockType::Water)
-	{
-		return neighborBlockType == BlockType::None;
-	}
-
-	return neighborBlockType == BlockType::None || isTransparentBlock(neighborBlockType);
+    size_t quads = 0;
+    if (m_mesh) quads += m_mesh->getQuadCount();
+    if (m_transparentMesh) quads += m_transparentMesh->getQuadCount();
+    return quads;
 }
 
-void Chunk::draw() const
+size_t Chunk::draw(uint8_t faceMask) const
 {
-	if (m_activeMesh) {
-        m_activeMesh->draw();
+	if (m_mesh) {
+        return m_mesh->draw(glm::ivec3(getWorldPosition()), faceMask);
 	}
+    return 0;
 }
 
-void Chunk::drawTransparent() const
+size_t Chunk::drawTransparent(uint8_t faceMask) const
 {
-    if (m_activeTransparentMesh) {
-        m_activeTransparentMesh->draw();
+    if (m_transparentMesh) {
+        return m_transparentMesh->draw(glm::ivec3(getWorldPosition()), faceMask);
     }
+    return 0;
 }
 
-std::array<float, 4> Chunk::getAmbientOcclusion(const glm::ivec3& pos, const glm::ivec3& dir) const {
-    int face = Atlas::faceIndexForDir(dir);
-    std::array<float, 4> outAo;
-
-    for (int v = 0; v < 4; ++v) {
-        // which of the eight neighbours to test:
-		glm::ivec3 aoIndices = m_neighborFaceIndices[v];
+size_t Chunk::appendDrawCommands(uint8_t faceMask, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) const
+{
+    if (m_mesh) {
+        return m_mesh->appendDrawCommands(faceMask, baseInstance, commands);
+    }
+    return 0;
+}
 
-		BlockType neighborTypeX = getNeighborType(pos, m_faceAos[face][aoIndices.x]);
-		BlockType neighborTypeZ = getNeighborType(pos, m_faceAos[face][aoIndices.z]);
-		BlockType neighborTypeY = getNeighborType(pos, m_faceAos[face][aoIndices.y]);
-		int s1 = neighborTypeX != BlockType::None && neighborTypeX != BlockType::Water;
-		int s2 = neighborTypeZ != BlockType::None && neighborTypeZ != BlockType::Water;
-		int c = neighborTypeY != BlockType::None && neighborTypeY != BlockType::Water;
+size_t Chunk::appendTransparentDrawCommands(uint8_t faceMask, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) const
+{
+    if (m_transparentMesh) {
+        return m_transparentMesh->appendDrawCommands(faceMask, baseInstance, commands);
+    }
+    return 0;
+}
 
-        int state = (s1 + s2 == 2)
-            ? 0
-            : 3 - (s1 + s2 + c);
+uint8_t Chunk::getAmbientOcclusion(const ChunkSnapshot& snapshot, const glm::ivec3& pos, const glm::ivec3& dir) {
+    const std::vector<glm::ivec3>& offsets = m_faceAos[Atlas::faceIndexForDir(dir)];
 
-        outAo[v] = m_aoValues[state];
+    // One bit per neighbor around the face, the table turns it into the 4 corner levels
+    uint8_t occupancy = 0;
+    for (int k = 0; k < 8; ++k) {
+        const glm::ivec3& o = offsets[k];
+        occupancy |= uint8_t(snapshot.isSolid(pos.x + o.x, pos.y + o.y, pos.z + o.z)) << k;
     }
-    return outAo;
-}
\ No newline at end of file
+    return m_aoLevelTable[occupancy];
+}
@@ -0,0 +1,222 @@
+#include "chunk_arena.h"
+#include <glad/glad.h>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+	const size_t QUAD_BYTES = 4 * sizeof(ChunkVertex);
+}
+
+ChunkArena::~ChunkArena()
+{
+	if (VAO) {
+		glDeleteVertexArrays(1, &VAO);
+	}
+	unsigned int buffers[] = { VBO, m_indexBuffer, m_originBuffer, m_indirectBuffer };
+	for (unsigned int buffer : buffers) {
+		if (buffer) {
+			glDeleteBuffers(1, &buffer);
+		}
+	}
+}
+
+void ChunkArena::init()
+{
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &m_indexBuffer);
+	glGenBuffers(1, &m_originBuffer);
+	glGenBuffers(1, &m_indirectBuffer);
+
+	glBindVertexArray(VAO);
+
+	// Chunk origin per draw (location 1), advanced once per instance so baseInstance selects it
+	glBindBuffer(GL_ARRAY_BUFFER, m_originBuffer);
+	glVertexAttribIPointer(1, 3, GL_INT, sizeof(glm::ivec4), (void*)0);
+	glVertexAttribDivisor(1, 1);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBindVertexArray(0);
+
+	grow(INITIAL_QUADS);
+}
+
+void ChunkArena::bindVertexBuffer()
+{
+	// Packed vertex as one uvec2 attribute (location 0)
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(ChunkVertex), (void*)0);
+	glBindVertexArray(0);
+}
+
+void ChunkArena::grow(uint32_t minQuads)
+{
+	uint32_t oldCapacity = m_capacity;
+	uint32_t capacity = oldCapacity ? oldCapacity : INITIAL_QUADS;
+	while (capacity < minQuads) {
+		capacity *= 2;
+	}
+	if (capacity == oldCapacity) {
+		return;
+	}
+
+	// Allocated ranges keep their offsets, their content is copied to the new buffer
+	unsigned int buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, size_t(capacity) * QUAD_BYTES, nullptr, GL_DYNAMIC_DRAW);
+	if (VBO) {
+		glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size_t(oldCapacity) * QUAD_BYTES);
+		glDeleteBuffers(1, &VBO);
+	}
+	VBO = buffer;
+	m_capacity = capacity;
+	bindVertexBuffer();
+
+	addFreeBlock(oldCapacity, capacity - oldCapacity);
+}
+
+uint32_t ChunkArena::allocate(uint32_t quads)
+{
+	if (!VAO) {
+		init();
+	}
+
+	// First fit
+	auto it = std::find_if(m_freeBlocks.begin(), m_freeBlocks.end(), [quads](const auto& block) { return block.second >= quads; });
+	if (it == m_freeBlocks.end()) {
+		// Grow so that the free block at the end of the buffer is large enough
+		uint32_t tail = 0;
+		if (!m_freeBlocks.empty()) {
+			auto last = std::prev(m_freeBlocks.end());
+			if (last->first + last->second == m_capacity) {
+				tail = last->second;
+			}
+		}
+		grow(m_capacity - tail + quads);
+		it = std::prev(m_freeBlocks.end());
+	}
+
+	uint32_t first = it->first;
+	uint32_t size = it->second;
+	m_freeBlocks.erase(it);
+	if (size > quads) {
+		m_freeBlocks[first + quads] = size - quads;
+	}
+	m_used += quads;
+	return first;
+}
+
+void ChunkArena::free(uint32_t firstQuad, uint32_t quads)
+{
+	if (quads == 0) {
+		return;
+	}
+	m_used -= quads;
+	addFreeBlock(firstQuad, quads);
+}
+
+void ChunkArena::addFreeBlock(uint32_t firstQuad, uint32_t quads)
+{
+	// Merge with the following and the preceding free blocks
+	auto next = m_freeBlocks.lower_bound(firstQuad);
+	if (next != m_freeBlocks.end() && firstQuad + quads == next->first) {
+		quads += next->second;
+		next = m_freeBlocks.erase(next);
+	}
+	if (next != m_freeBlocks.begin()) {
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == firstQuad) {
+			prev->second += quads;
+			return;
+		}
+	}
+	m_freeBlocks[firstQuad] = quads;
+}
+
+void ChunkArena::upload(uint32_t firstQuad, const ChunkVertex* vertices, size_t quads)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferSubData(GL_ARRAY_BUFFER, size_t(firstQuad) * QUAD_BYTES, quads * QUAD_BYTES, vertices);
+}
+
+void ChunkArena::copy(uint32_t srcQuad, uint32_t dstQuad, uint32_t quads)
+{
+	glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, size_t(srcQuad) * QUAD_BYTES, size_t(dstQuad) * QUAD_BYTES, size_t(quads) * QUAD_BYTES);
+}
+
+void ChunkArena::reserveIndices(size_t quadCount)
+{
+	if (quadCount <= m_indexQuadCapacity) {
+		return;
+	}
+
+	size_t capacity = m_indexQuadCapacity ? m_indexQuadCapacity : 4096;
+	while (capacity < quadCount) {
+		capacity *= 2;
+	}
+
+	std::vector<unsigned int> indices(capacity * 6);
+	for (size_t q = 0; q < capacity; ++q) {
+		unsigned int base = static_cast<unsigned int>(q * 4);
+		indices[q * 6 + 0] = base;
+		indices[q * 6 + 1] = base + 1;
+		indices[q * 6 + 2] = base + 2;
+		indices[q * 6 + 3] = base + 2;
+		indices[q * 6 + 4] = base + 1;
+		indices[q * 6 + 5] = base + 3;
+	}
+
+	// Reallocating the same buffer name keeps it valid in the VAO
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	m_indexQuadCapacity = capacity;
+}
+
+void ChunkArena::bind(const glm::ivec3& origin)
+{
+	glBindVertexArray(VAO);
+	glDisableVertexAttribArray(1);
+	// The current value of a disabled attribute is context state, set as integers
+	glVertexAttribI4i(1, origin.x, origin.y, origin.z, 0);
+}
+
+void ChunkArena::setDrawOrigins(const std::vector<glm::ivec4>& origins)
+{
+	if (!VAO) {
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, m_originBuffer);
+	glBufferData(GL_ARRAY_BUFFER, origins.size() * sizeof(glm::ivec4), origins.data(), GL_STREAM_DRAW);
+}
+
+int ChunkArena::drawIndirect(const std::vector<DrawElementsIndirectCommand>& commands)
+{
+	if (!VAO || commands.empty()) {
+		return 0;
+	}
+
+	glBindVertexArray(VAO);
+	glEnableVertexAttribArray(1);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(commands.size()), 0);
+
+	glBindVertexArray(0);
+	return 1;
+}
+
+size_t ChunkArena::getCapacityBytes() const
+{
+	return size_t(m_capacity) * QUAD_BYTES;
+}
+
+size_t ChunkArena::getUsedBytes() const
+{
+	return size_t(m_used) * QUAD_BYTES;
+}
@@ -0,0 +1,221 @@
+#include "chunk_mesh.h"
+#include "chunk_arena.h"
+#include "mesh_data.h"
+#include <glad/glad.h>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+	const size_t QUAD_BYTES = 4 * sizeof(ChunkVertex);
+}
+
+ChunkMesh::ChunkMesh(ChunkArena& arena) : m_arena(arena), m_firstQuad(0), m_bufferQuads(0), m_isSetup(false)
+{
+}
+
+ChunkMesh::~ChunkMesh()
+{
+	m_arena.free(m_firstQuad, m_bufferQuads);
+}
+
+size_t ChunkMesh::getQuadCount() const
+{
+	size_t quads = 0;
+	for (const Section& s : m_sections) {
+		quads += s.quadCount;
+	}
+	return quads;
+}
+
+size_t ChunkMesh::getCpuMemoryUsage() const
+{
+	size_t bytes = 0;
+	if (m_data) {
+		for (const MeshData::Section& s : m_data->sections) {
+			bytes += s.vertices.capacity() * sizeof(ChunkVertex);
+		}
+	}
+	return bytes;
+}
+
+size_t ChunkMesh::getGpuMemoryUsage() const
+{
+	return m_bufferQuads * QUAD_BYTES;
+}
+
+uint32_t ChunkMesh::slotCapacity(size_t quads)
+{
+	// Spare room so small edits are patched in place
+	return quads ? uint32_t(quads + quads / 4 + 16) : 0;
+}
+
+void ChunkMesh::allocate(uint8_t uploadMask, const MeshData& source)
+{
+	uint32_t oldFirstQuad = m_firstQuad;
+	uint32_t oldBufferQuads = m_bufferQuads;
+	uint32_t oldFirst[SECTION_COUNT];
+	size_t maxQuads = 0;
+
+	// Sections are laid out back to back, each with its own spare room
+	m_bufferQuads = 0;
+	for (int s = 0; s < SECTION_COUNT; ++s) {
+		Section& section = m_sections[s];
+		oldFirst[s] = section.firstQuad;
+		section.capacity = slotCapacity(section.quadCount);
+		section.firstQuad = m_bufferQuads;
+		m_bufferQuads += section.capacity;
+		maxQuads = std::max<size_t>(maxQuads, section.quadCount);
+	}
+
+	// The new range is taken before the old one is released, so untouched sections copy from it
+	m_firstQuad = m_bufferQuads > 0 ? m_arena.allocate(m_bufferQuads) : 0;
+	for (int s = 0; s < SECTION_COUNT; ++s) {
+		const Section& section = m_sections[s];
+		if (section.quadCount == 0) continue;
+
+		if ((uploadMask >> s) & 1) {
+			m_arena.upload(m_firstQuad + section.firstQuad, source.sections[s].vertices.data(), section.quadCount);
+		}
+		else if (oldBufferQuads > 0) {
+			m_arena.copy(oldFirstQuad + oldFirst[s], m_firstQuad + section.firstQuad, section.quadCount);
+		}
+	}
+	m_arena.free(oldFirstQuad, oldBufferQuads);
+
+	m_arena.reserveIndices(maxQuads);
+}
+
+void ChunkMesh::upload(std::unique_ptr<MeshData>& data, bool keepCpuData)
+{
+	const uint8_t allSections = (1 << SECTION_COUNT) - 1;
+	uint8_t sectionMask = m_isSetup ? data->sectionMask : allSections;
+
+	bool fits = true;
+	size_t maxQuads = 0;
+	for (int s = 0; s < SECTION_COUNT; ++s) {
+		if (!((sectionMask >> s) & 1)) continue;
+
+		Section& section = m_sections[s];
+		section.faceQuadCount = data->sections[s].faceQuadCount;
+		section.quadCount = data->sections[s].quadCount;
+		fits = fits && section.quadCount <= section.capacity;
+		maxQuads = std::max<size_t>(maxQuads, section.quadCount);
+	}
+
+	if (sectionMask == allSections || !fits) {
+		// New layout: a full mesh, or a section outgrew its slot and everything moves to a new range
+		allocate(sectionMask, *data);
+	}
+	else {
+		// Patch the sections in place
+		for (int s = 0; s < SECTION_COUNT; ++s) {
+			const Section& section = m_sections[s];
+			if (((sectionMask >> s) & 1) && section.quadCount > 0) {
+				m_arena.upload(m_firstQuad + section.firstQuad, data->sections[s].vertices.data(), section.quadCount);
+			}
+		}
+		m_arena.reserveIndices(maxQuads);
+	}
+
+	if (!keepCpuData) {
+		// GPU-resident: the counts and the arena range are all drawing needs
+		m_data.reset();
+	}
+	else if (sectionMask == allSections) {
+		// Adopt the whole payload, the previous one goes back to the caller
+		std::swap(m_data, data);
+		m_data->sectionMask = allSections;
+	}
+	else if (m_data) {
+		// Swap the remeshed sections in, the caller gets the replaced section buffers.
+		// A resident mesh stays resident, its CPU copy would be partial.
+		for (int s = 0; s < SECTION_COUNT; ++s) {
+			if ((sectionMask >> s) & 1) {
+				std::swap(m_data->sections[s], data->sections[s]);
+			}
+		}
+	}
+
+	GLenum err;
+	while ((err = glGetError()) != GL_NO_ERROR) {
+		std::cerr << "OpenGL error: " << err << std::endl;
+	}
+	m_isSetup = true;
+}
+
+size_t ChunkMesh::collectRuns(uint8_t faceMask, Run (&runs)[MAX_RUNS], int& runCount) const
+{
+	runCount = 0;
+	size_t drawn = 0;
+
+	for (const Section& section : m_sections) {
+		uint32_t first = 0;
+		bool extendRun = false;
+
+		for (int face = 0; face < 6; ++face) {
+			uint32_t quads = section.faceQuadCount[face];
+			if (quads && (faceMask >> face) & 1) {
+				if (extendRun) {
+					runs[runCount - 1].count += quads * 6;
+				}
+				else {
+					runs[runCount].count = quads * 6;
+					runs[runCount].firstIndex = first * 6;
+					runs[runCount].baseVertex = int32_t((m_firstQuad + section.firstQuad) * 4);
+					runCount++;
+				}
+				drawn += quads;
+				extendRun = true;
+			}
+			else if (quads) {
+				extendRun = false;
+			}
+			first += quads;
+		}
+	}
+	return drawn;
+}
+
+size_t ChunkMesh::draw(const glm::ivec3& origin, uint8_t faceMask) const
+{
+	if (!m_isSetup) {
+		std::cerr << "Chunk mesh is not set up!" << std::endl;
+		return 0;
+	}
+
+	Run runs[MAX_RUNS];
+	int runCount;
+	size_t drawn = collectRuns(faceMask, runs, runCount);
+	if (runCount == 0) {
+		return 0;
+	}
+
+	GLsizei counts[MAX_RUNS];
+	const void* offsets[MAX_RUNS];
+	GLint baseVertices[MAX_RUNS];
+	for (int i = 0; i < runCount; ++i) {
+		counts[i] = GLsizei(runs[i].count);
+		offsets[i] = (const void*)(runs[i].firstIndex * sizeof(unsigned int));
+		baseVertices[i] = runs[i].baseVertex;
+	}
+
+	m_arena.bind(origin);
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, runCount, baseVertices);
+	glBindVertexArray(0);
+	return drawn;
+}
+
+size_t ChunkMesh::appendDrawCommands(uint8_t faceMask, uint32_t baseInstance, std::vector<DrawElementsIndirectCommand>& commands) const
+{
+	if (!m_isSetup) {
+		return 0;
+	}
+
+	Run runs[MAX_RUNS];
+	int runCount;
+	size_t drawn = collectRuns(faceMask, runs, runCount);
+	for (int i = 0; i < runCount; ++i) {
+		commands.push_back({ runs[i].count, 1, runs[i].firstIndex, runs[i].baseVertex, baseInstance });
+	}
+	return drawn;
+}
@@ -0,0 +1,52 @@
+#include "chunk_snapshot.h"
+#include <cstring>
+
+void ChunkSnapshot::capture(const Chunk& chunk, const Neighbors& neighbors)
+{
+	const int size = Chunk::CHUNK_SIZE;
+
+	// Missing neighbors and the rows above and below the chunk read as air
+	memset(blocks, 0, sizeof(blocks));
+	memset(opaque, 0, sizeof(opaque));
+	memset(filled, 0, sizeof(filled));
+	memset(solid, 0, sizeof(solid));
+	memset(water, 0, sizeof(water));
+
+	for (int s = 0; s < Chunk::SECTION_COUNT; ++s) {
+		sectionUniform[s] = chunk.isSectionUniform(s);
+		sectionType[s] = chunk.m_sections[s].getUniformType();
+	}
+
+	// The chunk itself and the border cells of its 8 horizontal neighbors
+	for (int dx = -1; dx <= 1; ++dx) {
+		for (int dz = -1; dz <= 1; ++dz) {
+			const Chunk* source = &chunk;
+			if (dx != 0 || dz != 0) {
+				source = neighbors[dx + 1][dz + 1];
+			}
+			if (!source) continue;
+
+			int xBegin = dx < 0 ? 0 : (dx == 0 ? 1 : size + 1);
+			int xEnd = dx == 0 ? size + 1 : xBegin + 1;
+			int zBegin = dz < 0 ? 0 : (dz == 0 ? 1 : size + 1);
+			int zEnd = dz == 0 ? size + 1 : zBegin + 1;
+
+			for (int px = xBegin; px < xEnd; ++px) {
+				for (int pz = zBegin; pz < zEnd; ++pz) {
+					int x = px - 1 - dx * size;
+					int z = pz - 1 - dz * size;
+					opaque[px][pz] = source->getOpaqueColumn(x, z);
+					filled[px][pz] = source->getFilledColumn(x, z);
+					solid[px][pz] = source->getSolidColumn(x, z);
+					water[px][pz] = source->getWaterColumn(x, z);
+
+					// Air cells are already cleared, only decode the filled part of the column
+					int height = source->getColumnHeight(x, z);
+					for (int y = 0; y < height; ++y) {
+						blocks[px][y + 1][pz] = source->getBlock(x, y, z);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#include "frame_uniforms.h"
+#include <glad/glad.h>
+
+FrameUniforms::~FrameUniforms()
+{
+	if (m_buffer) {
+		glDeleteBuffers(1, &m_buffer);
+	}
+}
+
+void FrameUniforms::init()
+{
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, m_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniforms::update(const FrameUniformData& data)
+{
+	glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniformData), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
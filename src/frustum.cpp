@@ -0,0 +1,37 @@
+#include "frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// Rows of the matrix, glm is column-major
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i) {
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	m_planes[0] = rows[3] + rows[0]; // left
+	m_planes[1] = rows[3] - rows[0]; // right
+	m_planes[2] = rows[3] + rows[1]; // bottom
+	m_planes[3] = rows[3] - rows[1]; // top
+	m_planes[4] = rows[3] + rows[2]; // near
+	m_planes[5] = rows[3] - rows[2]; // far
+
+	for (glm::vec4& plane : m_planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+bool Frustum::isBoxVisible(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (const glm::vec4& plane : m_planes) {
+		// Corner furthest along the plane normal
+		glm::vec3 p(
+			plane.x >= 0.0f ? max.x : min.x,
+			plane.y >= 0.0f ? max.y : min.y,
+			plane.z >= 0.0f ? max.z : min.z);
+
+		if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
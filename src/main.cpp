@@ -4,7 +4,9 @@ int main(void)
 {
 	Application app;
 
-	app.init();
+	if (!app.init()) {
+		return -1;
+	}
 	app.run();
 	app.shutdown();
   
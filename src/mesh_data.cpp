@@ -0,0 +1,67 @@
+#include "mesh_data.h"
+
+void MeshData::addQuad(int section, const ChunkVertex& v1, const ChunkVertex& v2, const ChunkVertex& v3, const ChunkVertex& v4, bool flip)
+{
+	Section& s = sections[section];
+	s.faceQuadCount[(v1.position >> 19) & 7]++;
+	s.quadCount++;
+
+	if (!flip) {
+		// Triangles v1 v2 v3, v3 v2 v4
+		s.vertices.insert(s.vertices.end(), { v1, v2, v3, v4 });
+	}
+	else {
+		// Triangles v3 v1 v4, v4 v1 v2: same winding, split along the v1-v4 diagonal
+		s.vertices.insert(s.vertices.end(), { v3, v1, v4, v2 });
+	}
+}
+
+void MeshData::clear()
+{
+	for (Section& s : sections) {
+		s.vertices.clear();
+		s.faceQuadCount.fill(0);
+		s.quadCount = 0;
+	}
+	sectionMask = 0;
+}
+
+size_t MeshData::getQuadCount() const
+{
+	size_t quads = 0;
+	for (const Section& s : sections) {
+		quads += s.quadCount;
+	}
+	return quads;
+}
+
+std::unique_ptr<MeshData> MeshDataPool::acquire()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_free.empty()) {
+			std::unique_ptr<MeshData> data = std::move(m_free.back());
+			m_free.pop_back();
+			return data;
+		}
+	}
+
+	auto data = std::make_unique<MeshData>();
+	for (MeshData::Section& s : data->sections) {
+		s.vertices.reserve(RESERVED_VERTICES);
+	}
+	return data;
+}
+
+void MeshDataPool::release(std::unique_ptr<MeshData> data)
+{
+	if (!data) {
+		return;
+	}
+	data->clear();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_free.size() < MAX_FREE) {
+		m_free.push_back(std::move(data));
+	}
+}
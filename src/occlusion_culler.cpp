@@ -0,0 +1,310 @@
+#include "occlusion_culler.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef VOXL_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+OcclusionCuller::OcclusionCuller() : m_viewProjection(1.0f), m_eye(0.0f)
+{
+	for (int w = WIDTH, h = HEIGHT; w > 0 && h > 0; w /= 2, h /= 2) {
+		m_levels.emplace_back(size_t(w) * h, 1.0f);
+	}
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjection, const glm::vec3& eye)
+{
+	m_viewProjection = viewProjection;
+	m_eye = eye;
+	std::fill(m_levels[0].begin(), m_levels[0].end(), 1.0f);
+}
+
+OcclusionCuller::ScreenVertex OcclusionCuller::toScreen(const glm::vec4& clip) const
+{
+	float invW = 1.0f / clip.w;
+	return ScreenVertex{
+		(clip.x * invW * 0.5f + 0.5f) * WIDTH,
+		(clip.y * invW * 0.5f + 0.5f) * HEIGHT,
+		clip.z * invW
+	};
+}
+
+void OcclusionCuller::addColumnOccluders(const std::vector<int>& heights, int columns, int rows, const glm::vec3& origin,
+	float columnSize, float padding, std::vector<Box>& out)
+{
+	auto heightAt = [&](int x, int z) { return heights[size_t(z) * columns + x]; };
+
+	for (int z = 1; z < rows - 1; ++z) {
+		for (int x = 1; x < columns - 1; ++x) {
+			int height = heightAt(x, z);
+			if (float(height) <= 2 * padding) continue;
+
+			// A side stays when the three columns across it are at least as high: the padding
+			// ball around any point kept near that side is still inside solid columns
+			auto sideCovered = [&](int dx, int dz) {
+				for (int i = -1; i <= 1; ++i) {
+					int nx = dx != 0 ? x + dx : x + i;
+					int nz = dz != 0 ? z + dz : z + i;
+					if (heightAt(nx, nz) < height) return false;
+				}
+				return true;
+			};
+
+			glm::vec3 min = origin + glm::vec3(x * columnSize, 0.0f, z * columnSize);
+			glm::vec3 max = min + glm::vec3(columnSize, float(height), columnSize);
+			if (padding > 0.0f) {
+				min.y += padding;
+				max.y -= padding;
+				if (!sideCovered(-1, 0)) min.x += padding;
+				if (!sideCovered(1, 0)) max.x -= padding;
+				if (!sideCovered(0, -1)) min.z += padding;
+				if (!sideCovered(0, 1)) max.z -= padding;
+			}
+			out.push_back({ min, max });
+		}
+	}
+}
+
+void OcclusionCuller::rasterizeBox(const Box& box)
+{
+	const glm::vec3& lo = box.min;
+	const glm::vec3& hi = box.max;
+
+	// Only the faces turned towards the eye, none when the eye is inside the box
+	if (m_eye.x < lo.x) rasterizeQuad({ lo.x, lo.y, lo.z }, { lo.x, lo.y, hi.z }, { lo.x, hi.y, hi.z }, { lo.x, hi.y, lo.z });
+	if (m_eye.x > hi.x) rasterizeQuad({ hi.x, lo.y, lo.z }, { hi.x, hi.y, lo.z }, { hi.x, hi.y, hi.z }, { hi.x, lo.y, hi.z });
+	if (m_eye.y < lo.y) rasterizeQuad({ lo.x, lo.y, lo.z }, { hi.x, lo.y, lo.z }, { hi.x, lo.y, hi.z }, { lo.x, lo.y, hi.z });
+	if (m_eye.y > hi.y) rasterizeQuad({ lo.x, hi.y, lo.z }, { lo.x, hi.y, hi.z }, { hi.x, hi.y, hi.z }, { hi.x, hi.y, lo.z });
+	if (m_eye.z < lo.z) rasterizeQuad({ lo.x, lo.y, lo.z }, { lo.x, hi.y, lo.z }, { hi.x, hi.y, lo.z }, { hi.x, lo.y, lo.z });
+	if (m_eye.z > hi.z) rasterizeQuad({ lo.x, lo.y, hi.z }, { hi.x, lo.y, hi.z }, { hi.x, hi.y, hi.z }, { lo.x, hi.y, hi.z });
+}
+
+void OcclusionCuller::rasterizeQuad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+{
+	glm::vec4 in[4] = {
+		m_viewProjection * glm::vec4(a, 1.0f),
+		m_viewProjection * glm::vec4(b, 1.0f),
+		m_viewProjection * glm::vec4(c, 1.0f),
+		m_viewProjection * glm::vec4(d, 1.0f)
+	};
+
+	// Clip against the near plane (z >= -w), a quad becomes at most a pentagon
+	glm::vec4 out[5];
+	int count = 0;
+	for (int i = 0; i < 4; ++i) {
+		const glm::vec4& p = in[i];
+		const glm::vec4& q = in[(i + 1) % 4];
+		float dp = p.z + p.w;
+		float dq = q.z + q.w;
+		if (dp >= 0.0f) {
+			out[count++] = p;
+		}
+		if ((dp >= 0.0f) != (dq >= 0.0f)) {
+			float t = dp / (dp - dq);
+			out[count++] = p + (q - p) * t;
+		}
+	}
+	if (count < 3) {
+		return;
+	}
+
+	ScreenVertex screen[5];
+	for (int i = 0; i < count; ++i) {
+		screen[i] = toScreen(out[i]);
+	}
+	for (int i = 1; i + 1 < count; ++i) {
+		rasterizeTriangle(screen[0], screen[i], screen[i + 1]);
+	}
+}
+
+void OcclusionCuller::rasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& in1, const ScreenVertex& in2)
+{
+	// Counter-clockwise order, either winding is accepted
+	float area = (in1.x - v0.x) * (in2.y - v0.y) - (in2.x - v0.x) * (in1.y - v0.y);
+	if (std::abs(area) < 1e-6f) {
+		return;
+	}
+	const ScreenVertex& v1 = area > 0.0f ? in1 : in2;
+	const ScreenVertex& v2 = area > 0.0f ? in2 : in1;
+	area = std::abs(area);
+
+	// Pixels fully inside the triangle lie within its bounding box
+	int xMin = std::max(0, int(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+	int xMax = std::min(WIDTH - 1, int(std::ceil(std::max({ v0.x, v1.x, v2.x }))) - 1);
+	int yMin = std::max(0, int(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+	int yMax = std::min(HEIGHT - 1, int(std::ceil(std::max({ v0.y, v1.y, v2.y }))) - 1);
+	if (xMin > xMax || yMin > yMax) {
+		return;
+	}
+
+	// Edge functions E = a x + b y + c, positive inside. A pixel is fully covered when E at its
+	// center exceeds half the spread of E over the pixel, (|a| + |b|) / 2.
+	const ScreenVertex* v[3] = { &v0, &v1, &v2 };
+	float ea[3], eb[3], ec[3], threshold[3];
+	for (int i = 0; i < 3; ++i) {
+		const ScreenVertex& p = *v[i];
+		const ScreenVertex& q = *v[(i + 1) % 3];
+		ea[i] = p.y - q.y;
+		eb[i] = q.x - p.x;
+		ec[i] = -(ea[i] * p.x + eb[i] * p.y);
+		threshold[i] = 0.5f * (std::abs(ea[i]) + std::abs(eb[i]));
+	}
+
+	// Depth plane, evaluated at the farthest corner of each pixel and capped by the farthest vertex
+	float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+	float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+	float zBias = 0.5f * (std::abs(dzdx) + std::abs(dzdy));
+	float zMax = std::max({ v0.z, v1.z, v2.z });
+
+	std::vector<float>& depth = m_levels[0];
+
+	for (int y = yMin; y <= yMax; ++y) {
+		float cy = float(y) + 0.5f;
+		float row[3];
+		for (int i = 0; i < 3; ++i) {
+			row[i] = eb[i] * cy + ec[i];
+		}
+		float zRow = v0.z + dzdy * (cy - v0.y) - dzdx * v0.x + zBias;
+		float* line = &depth[size_t(y) * WIDTH];
+
+#ifdef VOXL_OCCLUSION_SSE
+		if (useSimd) {
+			// 4 pixels at a time from an aligned column, WIDTH is a multiple of 4
+			const __m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			for (int x = xMin & ~3; x <= xMax; x += 4) {
+				__m128 cx = _mm_add_ps(_mm_set1_ps(float(x)), lane);
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[0]), cx), _mm_set1_ps(row[0])), _mm_set1_ps(threshold[0]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[1]), cx), _mm_set1_ps(row[1])), _mm_set1_ps(threshold[1])));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(ea[2]), cx), _mm_set1_ps(row[2])), _mm_set1_ps(threshold[2])));
+				if (_mm_movemask_ps(inside) == 0) continue;
+
+				__m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), cx), _mm_set1_ps(zRow)), _mm_set1_ps(zMax));
+				__m128 old = _mm_loadu_ps(line + x);
+				__m128 nearest = _mm_min_ps(old, z);
+				_mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+			}
+			continue;
+		}
+#endif
+		for (int x = xMin; x <= xMax; ++x) {
+			float cx = float(x) + 0.5f;
+			if (ea[0] * cx + row[0] >= threshold[0] && ea[1] * cx + row[1] >= threshold[1] && ea[2] * cx + row[2] >= threshold[2]) {
+				float z = std::min(dzdx * cx + zRow, zMax);
+				line[x] = std::min(line[x], z);
+			}
+		}
+	}
+}
+
+void OcclusionCuller::buildHiZ()
+{
+	for (size_t level = 1; level < m_levels.size(); ++level) {
+		const std::vector<float>& src = m_levels[level - 1];
+		std::vector<float>& dst = m_levels[level];
+		int srcWidth = WIDTH >> (level - 1);
+		int width = WIDTH >> level;
+		int height = HEIGHT >> level;
+
+		// Farthest depth of each 2x2 block
+		for (int y = 0; y < height; ++y) {
+			const float* top = &src[size_t(y * 2) * srcWidth];
+			const float* bottom = top + srcWidth;
+			for (int x = 0; x < width; ++x) {
+				dst[size_t(y) * width + x] = std::max(std::max(top[x * 2], top[x * 2 + 1]), std::max(bottom[x * 2], bottom[x * 2 + 1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::isBoxVisible(const Box& box) const
+{
+	float xMin = float(WIDTH), xMax = 0.0f;
+	float yMin = float(HEIGHT), yMax = 0.0f;
+	float zNear = 1.0f;
+
+	for (int i = 0; i < 8; ++i) {
+		glm::vec3 corner(
+			(i & 1) ? box.max.x : box.min.x,
+			(i & 2) ? box.max.y : box.min.y,
+			(i & 4) ? box.max.z : box.min.z);
+		glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1.0f);
+
+		// Crossing the near plane, too close to be hidden
+		if (clip.z < -clip.w) {
+			return true;
+		}
+		ScreenVertex p = toScreen(clip);
+		xMin = std::min(xMin, p.x);
+		xMax = std::max(xMax, p.x);
+		yMin = std::min(yMin, p.y);
+		yMax = std::max(yMax, p.y);
+		zNear = std::min(zNear, p.z);
+	}
+
+	// Off screen boxes are left to frustum culling
+	if (xMax <= 0.0f || yMax <= 0.0f || xMin >= float(WIDTH) || yMin >= float(HEIGHT)) {
+		return true;
+	}
+	if (partialBoxesVisible && (xMin < 0.0f || yMin < 0.0f || xMax > float(WIDTH) || yMax > float(HEIGHT))) {
+		return true;
+	}
+
+	// Every pixel the screen rectangle touches
+	int px0 = std::max(0, int(std::floor(xMin)));
+	int px1 = std::min(WIDTH - 1, int(std::floor(xMax)));
+	int py0 = std::max(0, int(std::floor(yMin)));
+	int py1 = std::min(HEIGHT - 1, int(std::floor(yMax)));
+
+	// Coarsest level needed to cover the rectangle with at most 4x4 texels
+	size_t level = 0;
+	while (level + 1 < m_levels.size() && ((px1 >> level) - (px0 >> level) > 3 || (py1 >> level) - (py0 >> level) > 3)) {
+		++level;
+	}
+
+	const std::vector<float>& depth = m_levels[level];
+	int width = WIDTH >> level;
+	for (int y = py0 >> level; y <= py1 >> level; ++y) {
+		for (int x = px0 >> level; x <= px1 >> level; ++x) {
+			if (depth[size_t(y) * width + x] >= zNear) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void OcclusionCuller::cullAsync(const glm::mat4& viewProjection, const glm::vec3& eye, std::vector<Box>& occluders, std::vector<Box>& candidates)
+{
+	waitResults();
+
+	std::swap(m_occluders, occluders);
+	std::swap(m_candidates, candidates);
+	occluders.clear();
+	candidates.clear();
+
+	auto done = std::make_shared<std::promise<void>>();
+	m_pending = done->get_future();
+
+	m_worker.enqueue([this, viewProjection, eye, done]() {
+		beginFrame(viewProjection, eye);
+		for (const Box& box : m_occluders) {
+			rasterizeBox(box);
+		}
+		buildHiZ();
+
+		m_results.resize(m_candidates.size());
+		for (size_t i = 0; i < m_candidates.size(); ++i) {
+			m_results[i] = isBoxVisible(m_candidates[i]);
+		}
+		done->set_value();
+	});
+}
+
+const std::vector<uint8_t>& OcclusionCuller::waitResults()
+{
+	if (m_pending.valid()) {
+		m_pending.get();
+	}
+	return m_results;
+}
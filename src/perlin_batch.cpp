@@ -0,0 +1,357 @@
+#include "perlin_batch.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PERLIN_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC accepts any intrinsic without a target flag
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+	// FastNoiseLite's hashing and scaling constants
+	const uint32_t PRIME_X = 501125321u;
+	const uint32_t PRIME_Y = 1136930381u;
+	const uint32_t HASH_MULTIPLIER = 0x27d4eb2du;
+	const float PERLIN_SCALE = 1.4247691104677813f;
+
+	// FastNoiseLite's GRADIENTS_2D: these 24 directions repeated over the first 120 entries,
+	// then the 8 diagonals of TAIL_DIRECTIONS
+	constexpr float DIRECTIONS[24][2] = {
+		{ 0.130526192220052f, 0.99144486137381f }, { 0.38268343236509f, 0.923879532511287f },
+		{ 0.608761429008721f, 0.793353340291235f }, { 0.793353340291235f, 0.608761429008721f },
+		{ 0.923879532511287f, 0.38268343236509f }, { 0.99144486137381f, 0.130526192220051f },
+		{ 0.99144486137381f, -0.130526192220051f }, { 0.923879532511287f, -0.38268343236509f },
+		{ 0.793353340291235f, -0.60876142900872f }, { 0.608761429008721f, -0.793353340291235f },
+		{ 0.38268343236509f, -0.923879532511287f }, { 0.130526192220052f, -0.99144486137381f },
+		{ -0.130526192220052f, -0.99144486137381f }, { -0.38268343236509f, -0.923879532511287f },
+		{ -0.608761429008721f, -0.793353340291235f }, { -0.793353340291235f, -0.608761429008721f },
+		{ -0.923879532511287f, -0.38268343236509f }, { -0.99144486137381f, -0.130526192220052f },
+		{ -0.99144486137381f, 0.130526192220051f }, { -0.923879532511287f, 0.38268343236509f },
+		{ -0.793353340291235f, 0.608761429008721f }, { -0.608761429008721f, 0.793353340291235f },
+		{ -0.38268343236509f, 0.923879532511287f }, { -0.130526192220052f, 0.99144486137381f },
+	};
+
+	constexpr float TAIL_DIRECTIONS[8][2] = {
+		{ 0.38268343236509f, 0.923879532511287f }, { 0.923879532511287f, 0.38268343236509f },
+		{ 0.923879532511287f, -0.38268343236509f }, { 0.38268343236509f, -0.923879532511287f },
+		{ -0.38268343236509f, -0.923879532511287f }, { -0.923879532511287f, -0.38268343236509f },
+		{ -0.923879532511287f, 0.38268343236509f }, { -0.38268343236509f, 0.923879532511287f },
+	};
+
+	// Split in x and y tables so a gather fetches one component for every lane
+	struct GradientTable {
+		alignas(32) float x[128];
+		alignas(32) float y[128];
+	};
+
+	constexpr GradientTable makeGradients()
+	{
+		GradientTable table{};
+		for (int i = 0; i < 120; ++i) {
+			table.x[i] = DIRECTIONS[i % 24][0];
+			table.y[i] = DIRECTIONS[i % 24][1];
+		}
+		for (int i = 0; i < 8; ++i) {
+			table.x[120 + i] = TAIL_DIRECTIONS[i][0];
+			table.y[120 + i] = TAIL_DIRECTIONS[i][1];
+		}
+		return table;
+	}
+
+	constexpr GradientTable GRADIENTS = makeGradients();
+
+	// Not a true floor for negative integers, kept as FastNoiseLite has it
+	inline int fastFloor(float f) { return f >= 0 ? (int)f : (int)f - 1; }
+
+	inline float lerp(float a, float b, float t) { return a + t * (b - a); }
+
+	inline float interpQuintic(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+
+	// Unsigned arithmetic wraps like the signed original, the shifted bits are masked out
+	inline uint32_t gradientIndex(uint32_t seed, uint32_t xPrimed, uint32_t yPrimed)
+	{
+		uint32_t hash = (seed ^ xPrimed ^ yPrimed) * HASH_MULTIPLIER;
+		hash ^= hash >> 15;
+		return (hash >> 1) & 127;
+	}
+
+	inline float gradCoord(uint32_t seed, uint32_t xPrimed, uint32_t yPrimed, float xd, float yd)
+	{
+		uint32_t i = gradientIndex(seed, xPrimed, yPrimed);
+		return xd * GRADIENTS.x[i] + yd * GRADIENTS.y[i];
+	}
+
+	// Terms shared by every column of a grid row
+	struct Row {
+		float yd0, yd1, ys;
+		uint32_t y0, y1;  // primed
+	};
+
+	inline Row makeRow(int z, float frequency)
+	{
+		float y = float(z) * frequency;
+		int y0 = fastFloor(y);
+		Row row;
+		row.yd0 = y - float(y0);
+		row.yd1 = row.yd0 - 1;
+		row.ys = interpQuintic(row.yd0);
+		row.y0 = uint32_t(y0) * PRIME_Y;
+		row.y1 = row.y0 + PRIME_Y;
+		return row;
+	}
+
+#ifdef PERLIN_BATCH_X86
+	TARGET_SSE41 inline __m128 lerp4(__m128 a, __m128 b, __m128 t)
+	{
+		return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+	}
+
+	TARGET_SSE41 inline __m128 interpQuintic4(__m128 t)
+	{
+		__m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+		__m128 poly = _mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f)));
+		return _mm_mul_ps(t3, _mm_add_ps(poly, _mm_set1_ps(10.0f)));
+	}
+
+	TARGET_SSE41 inline __m128 gradCoord4(__m128i seed, __m128i xPrimed, __m128i yPrimed, __m128 xd, __m128 yd)
+	{
+		__m128i hash = _mm_mullo_epi32(_mm_xor_si128(_mm_xor_si128(seed, xPrimed), yPrimed), _mm_set1_epi32(int(HASH_MULTIPLIER)));
+		hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 15));
+		__m128i index = _mm_and_si128(_mm_srli_epi32(hash, 1), _mm_set1_epi32(127));
+
+		// No gather before AVX2
+		alignas(16) uint32_t i[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(i), index);
+		__m128 gx = _mm_setr_ps(GRADIENTS.x[i[0]], GRADIENTS.x[i[1]], GRADIENTS.x[i[2]], GRADIENTS.x[i[3]]);
+		__m128 gy = _mm_setr_ps(GRADIENTS.y[i[0]], GRADIENTS.y[i[1]], GRADIENTS.y[i[2]], GRADIENTS.y[i[3]]);
+		return _mm_add_ps(_mm_mul_ps(xd, gx), _mm_mul_ps(yd, gy));
+	}
+
+	TARGET_AVX2 inline __m256 lerp8(__m256 a, __m256 b, __m256 t)
+	{
+		return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+	}
+
+	TARGET_AVX2 inline __m256 interpQuintic8(__m256 t)
+	{
+		__m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+		__m256 poly = _mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f)));
+		return _mm256_mul_ps(t3, _mm256_add_ps(poly, _mm256_set1_ps(10.0f)));
+	}
+
+	TARGET_AVX2 inline __m256 gradCoord8(__m256i seed, __m256i xPrimed, __m256i yPrimed, __m256 xd, __m256 yd)
+	{
+		__m256i hash = _mm256_mullo_epi32(_mm256_xor_si256(_mm256_xor_si256(seed, xPrimed), yPrimed), _mm256_set1_epi32(int(HASH_MULTIPLIER)));
+		hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 15));
+		__m256i index = _mm256_and_si256(_mm256_srli_epi32(hash, 1), _mm256_set1_epi32(127));
+
+		__m256 gx = _mm256_i32gather_ps(GRADIENTS.x, index, 4);
+		__m256 gy = _mm256_i32gather_ps(GRADIENTS.y, index, 4);
+		return _mm256_add_ps(_mm256_mul_ps(xd, gx), _mm256_mul_ps(yd, gy));
+	}
+#endif
+}
+
+PerlinBatch::PerlinBatch(int seed, float frequency) : m_seed(seed), m_frequency(frequency)
+{
+}
+
+void PerlinBatch::sampleGrid(int originX, int originZ, int width, int depth, float* out) const
+{
+	static const Path bestPath = getBestPath();
+	sampleGrid(originX, originZ, width, depth, out, bestPath);
+}
+
+void PerlinBatch::sampleGrid(int originX, int originZ, int width, int depth, float* out, Path path) const
+{
+	for (int z = 0; z < depth; ++z) {
+		float* row = out + z * width;
+		switch (path) {
+		case Path::AVX2:
+			sampleRowAVX2(originX, width, originZ + z, row);
+			break;
+		case Path::SSE41:
+			sampleRowSSE41(originX, width, originZ + z, row);
+			break;
+		default:
+			sampleRowScalar(originX, width, originZ + z, row);
+			break;
+		}
+	}
+}
+
+float PerlinBatch::sample(int x, int z) const
+{
+	float value;
+	sampleRowScalar(x, 1, z, &value);
+	return value;
+}
+
+void PerlinBatch::sampleRowScalar(int originX, int width, int z, float* out) const
+{
+	const Row row = makeRow(z, m_frequency);
+	const uint32_t seed = uint32_t(m_seed);
+
+	for (int i = 0; i < width; ++i) {
+		float x = float(originX + i) * m_frequency;
+		int x0 = fastFloor(x);
+		float xd0 = x - float(x0);
+		float xd1 = xd0 - 1;
+		float xs = interpQuintic(xd0);
+
+		uint32_t x0p = uint32_t(x0) * PRIME_X;
+		uint32_t x1p = x0p + PRIME_X;
+
+		float xf0 = lerp(gradCoord(seed, x0p, row.y0, xd0, row.yd0), gradCoord(seed, x1p, row.y0, xd1, row.yd0), xs);
+		float xf1 = lerp(gradCoord(seed, x0p, row.y1, xd0, row.yd1), gradCoord(seed, x1p, row.y1, xd1, row.yd1), xs);
+		out[i] = lerp(xf0, xf1, row.ys) * PERLIN_SCALE;
+	}
+}
+
+#ifdef PERLIN_BATCH_X86
+
+TARGET_SSE41 void PerlinBatch::sampleRowSSE41(int originX, int width, int z, float* out) const
+{
+	const Row row = makeRow(z, m_frequency);
+	const __m128i seed = _mm_set1_epi32(m_seed);
+	const __m128i primeX = _mm_set1_epi32(int(PRIME_X));
+	const __m128i y0p = _mm_set1_epi32(int(row.y0));
+	const __m128i y1p = _mm_set1_epi32(int(row.y1));
+	const __m128 yd0 = _mm_set1_ps(row.yd0);
+	const __m128 yd1 = _mm_set1_ps(row.yd1);
+	const __m128 ys = _mm_set1_ps(row.ys);
+	const __m128 frequency = _mm_set1_ps(m_frequency);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+
+	int i = 0;
+	for (; i + 4 <= width; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(originX + i), lanes)), frequency);
+		// Truncate, minus one where negative (the compare mask is -1)
+		__m128i x0 = _mm_add_epi32(_mm_cvttps_epi32(x), _mm_castps_si128(_mm_cmplt_ps(x, _mm_setzero_ps())));
+		__m128 xd0 = _mm_sub_ps(x, _mm_cvtepi32_ps(x0));
+		__m128 xd1 = _mm_sub_ps(xd0, one);
+		__m128 xs = interpQuintic4(xd0);
+
+		__m128i x0p = _mm_mullo_epi32(x0, primeX);
+		__m128i x1p = _mm_add_epi32(x0p, primeX);
+
+		__m128 xf0 = lerp4(gradCoord4(seed, x0p, y0p, xd0, yd0), gradCoord4(seed, x1p, y0p, xd1, yd0), xs);
+		__m128 xf1 = lerp4(gradCoord4(seed, x0p, y1p, xd0, yd1), gradCoord4(seed, x1p, y1p, xd1, yd1), xs);
+		_mm_storeu_ps(out + i, _mm_mul_ps(lerp4(xf0, xf1, ys), _mm_set1_ps(PERLIN_SCALE)));
+	}
+	if (i < width) {
+		sampleRowScalar(originX + i, width - i, z, out + i);
+	}
+}
+
+TARGET_AVX2 void PerlinBatch::sampleRowAVX2(int originX, int width, int z, float* out) const
+{
+	const Row row = makeRow(z, m_frequency);
+	const __m256i seed = _mm256_set1_epi32(m_seed);
+	const __m256i primeX = _mm256_set1_epi32(int(PRIME_X));
+	const __m256i y0p = _mm256_set1_epi32(int(row.y0));
+	const __m256i y1p = _mm256_set1_epi32(int(row.y1));
+	const __m256 yd0 = _mm256_set1_ps(row.yd0);
+	const __m256 yd1 = _mm256_set1_ps(row.yd1);
+	const __m256 ys = _mm256_set1_ps(row.ys);
+	const __m256 frequency = _mm256_set1_ps(m_frequency);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	int i = 0;
+	for (; i + 8 <= width; i += 8) {
+		__m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(originX + i), lanes)), frequency);
+		__m256i x0 = _mm256_add_epi32(_mm256_cvttps_epi32(x), _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ)));
+		__m256 xd0 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(x0));
+		__m256 xd1 = _mm256_sub_ps(xd0, one);
+		__m256 xs = interpQuintic8(xd0);
+
+		__m256i x0p = _mm256_mullo_epi32(x0, primeX);
+		__m256i x1p = _mm256_add_epi32(x0p, primeX);
+
+		__m256 xf0 = lerp8(gradCoord8(seed, x0p, y0p, xd0, yd0), gradCoord8(seed, x1p, y0p, xd1, yd0), xs);
+		__m256 xf1 = lerp8(gradCoord8(seed, x0p, y1p, xd0, yd1), gradCoord8(seed, x1p, y1p, xd1, yd1), xs);
+		_mm256_storeu_ps(out + i, _mm256_mul_ps(lerp8(xf0, xf1, ys), _mm256_set1_ps(PERLIN_SCALE)));
+	}
+	if (i < width) {
+		sampleRowSSE41(originX + i, width - i, z, out + i);
+	}
+}
+
+bool PerlinBatch::isSupported(Path path)
+{
+	switch (path) {
+	case Path::Scalar:
+		return true;
+#if defined(_MSC_VER) && !defined(__clang__)
+	case Path::SSE41:
+	case Path::AVX2: {
+		int info[4];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] >> 19) & 1;
+		if (path == Path::SSE41) {
+			return sse41;
+		}
+		// AVX state must also be enabled by the OS
+		bool osxsave = (info[2] >> 27) & 1;
+		bool avx = (info[2] >> 28) & 1;
+		if (!sse41 || !osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] >> 5) & 1;
+	}
+#else
+	case Path::SSE41:
+		return __builtin_cpu_supports("sse4.1");
+	case Path::AVX2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.1");
+#endif
+	}
+	return false;
+}
+
+#else
+
+// Other architectures only have the scalar path
+void PerlinBatch::sampleRowSSE41(int originX, int width, int z, float* out) const
+{
+	sampleRowScalar(originX, width, z, out);
+}
+
+void PerlinBatch::sampleRowAVX2(int originX, int width, int z, float* out) const
+{
+	sampleRowScalar(originX, width, z, out);
+}
+
+bool PerlinBatch::isSupported(Path path)
+{
+	return path == Path::Scalar;
+}
+
+#endif
+
+PerlinBatch::Path PerlinBatch::getBestPath()
+{
+	if (isSupported(Path::AVX2)) return Path::AVX2;
+	if (isSupported(Path::SSE41)) return Path::SSE41;
+	return Path::Scalar;
+}
+
+const char* PerlinBatch::getPathName(Path path)
+{
+	switch (path) {
+	case Path::AVX2: return "AVX2";
+	case Path::SSE41: return "SSE4.1";
+	default: return "Scalar";
+	}
+}
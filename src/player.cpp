@@ -133,6 +133,26 @@ void Player::processInput(GLFWwindow* window, float deltaTime)
         m_world->setAmbientOcclusion();
     });
 
+    onPressedKey(GLFW_KEY_F4, [&]() {
+        m_world->setBinaryMesher();
+    });
+
+    onPressedKey(GLFW_KEY_F5, [&]() {
+        m_world->setGpuResidentMeshes();
+    });
+
+    onPressedKey(GLFW_KEY_F6, [&]() {
+        m_world->useIndirectDraw = !m_world->useIndirectDraw;
+    });
+
+    onPressedKey(GLFW_KEY_F7, [&]() {
+        m_world->useOcclusionCulling = !m_world->useOcclusionCulling;
+    });
+
+    onPressedKey(GLFW_KEY_F8, [&]() {
+        m_world->useConnectivityCulling = !m_world->useConnectivityCulling;
+    });
+
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
@@ -154,7 +174,7 @@ void Player::processInput(GLFWwindow* window, float deltaTime)
                     localBlockPos.x < Chunk::CHUNK_SIZE && localBlockPos.y < Chunk::CHUNK_HEIGHT && localBlockPos.z < Chunk::CHUNK_SIZE) {
                     chunk->setBlockType(localBlockPos.x, localBlockPos.y, localBlockPos.z, BlockType::Dirt);
 
-                    m_world->updateChunk(chunk);
+                    m_world->updateBlock(chunk, localBlockPos);
                 }
             }
         }
@@ -175,7 +195,7 @@ void Player::processInput(GLFWwindow* window, float deltaTime)
                     localBlockPos.x < Chunk::CHUNK_SIZE && localBlockPos.y < Chunk::CHUNK_HEIGHT && localBlockPos.z < Chunk::CHUNK_SIZE) {
                     chunk->setBlockType(localBlockPos.x, localBlockPos.y, localBlockPos.z, BlockType::None);
 
-                    m_world->updateChunk(chunk);
+                    m_world->updateBlock(chunk, localBlockPos);
                 }
             }
         }
@@ -364,7 +384,8 @@ bool Player::rayCast(float maxDistance, glm::vec3& outBlockPosition, glm::vec3&
 
         glm::ivec3 blockPos = glm::ivec3(blockX, blockY, blockZ);
 
-        if (m_nonSelectableBlockTypes.find(chunk->cubes[blockPos.x][blockPos.y][blockPos.z]) == m_nonSelectableBlockTypes.end()) {
+        // Air and water are not selectable, everything solid is
+        if (chunk->isSolid(blockPos.x, blockPos.y, blockPos.z)) {
             glm::vec3 blockCenter = chunk->getWorldPosition() + glm::vec3(blockPos) + glm::vec3(0.5f);
             glm::vec3 delta = currentPos - blockCenter;
 
@@ -1,6 +1,11 @@
 ﻿#include "glad/glad.h"
 #include "renderer.h"
+#include "frustum.h"
 #include <iostream>
+#include <filesystem>
+#include <cstdio>
+#include <chrono>
+#include <climits>
 #include "voxl.h"
 #include <texture.h>
 #include <imgui.h>
@@ -27,23 +32,26 @@ bool Renderer::init()
 		return true;
 	}
 
-	// Set the OpenGL version and profile
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-   
 	// Initialize GLFW
 	if (!glfwInit())
 	{
 		std::cerr << "Failed to initialize GLFW" << std::endl;
+		return false;
 	}
 
+	// Set the OpenGL version and profile, glfwInit resets the hints so they follow it.
+	// The shaders and multi-draw-indirect need 4.5 core, window creation fails without it.
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
 	// Create a windowed mode window and its OpenGL context
 	window = glfwCreateWindow(window_width, window_height, "Voxl", NULL, NULL);
 	if (!window)
 	{
 		glfwTerminate();
 		std::cerr << "Failed to create GLFW window" << std::endl;
+		return false;
 	}
 	// Make the window's context current
 	glfwMakeContextCurrent(window);
@@ -69,25 +77,52 @@ bool Renderer::init()
 	skybox->init();
 
 	
-	// Shader initialization
-	shader = std::make_unique<Shader>(VOXL_RES_DIR "/shaders/default_vert.glsl", VOXL_RES_DIR"/shaders/default_frag.glsl");
+	// Shader initialization, linked programs are reused from the binary cache when the sources and driver match
+	Shader::setBinaryCacheDirectory("shader_cache");
+	m_chunkShaders = std::make_unique<ShaderVariants>(VOXL_RES_DIR "/shaders/default_vert.glsl", VOXL_RES_DIR "/shaders/default_frag.glsl",
+		std::vector<std::string>{ "AMBIENT_OCCLUSION", "WIREFRAME" });
+	// Compile the default variant up front, the others on first use
+	m_chunkShaders->get(ChunkAmbientOcclusion);
 
 	highlightShader = std::make_unique<Shader>(VOXL_RES_DIR "/shaders/highlight_vert.glsl", VOXL_RES_DIR "/shaders/highlight_frag.glsl");
+	m_highlightModel = highlightShader->getUniform("uModel");
 
 	skyShader = std::make_unique<Shader>(VOXL_RES_DIR "/shaders/sky_vert.glsl", VOXL_RES_DIR "/shaders/sky_frag.glsl");
 
-	// Texture atlas initialization
+	// Sun look does not change, set it once
+	skyShader->bind();
+	skyShader->setUniform3f(skyShader->getUniform("uSunColor"), 1.0f, 0.96f, 0.85f);
+	skyShader->setUniform1f(skyShader->getUniform("uSunAngularRadius"), 0.035f);
+	skyShader->setUniform1f(skyShader->getUniform("uSunSoftness"), 0.015f);
+	skyShader->setUniform1f(skyShader->getUniform("uSunIntensity"), 1.0f);
+
+	reportShaderStartup({ &m_chunkShaders->get(ChunkAmbientOcclusion), highlightShader.get(), skyShader.get() });
+
+	// Per-frame uniforms, read by every program through their block binding
+	m_frameUniforms.init();
+
+	// Texture atlas initialization: the prebuilt pack (see tools/texture_packer) when there is one,
+	// otherwise the atlas image is decoded and sliced here
+	auto textureStart = std::chrono::steady_clock::now();
 	Texture textureAtlas;
-	bool textureLoaded = textureAtlas.loadTextureArrayFromFile(VOXL_RES_DIR "/textures/default_texture.png", Atlas::COLS, Atlas::ROWS);
+	bool textureLoaded = false;
+	const char* textureSource = "pack";
+#ifdef VOXL_PACK_DIR
+	textureLoaded = textureAtlas.loadTextureArrayFromPack(VOXL_PACK_DIR "/default_texture.vxtp");
+#endif
+	if (!textureLoaded) {
+		textureSource = "png";
+		textureLoaded = textureAtlas.loadTextureArrayFromFile(VOXL_RES_DIR "/textures/default_texture.png", Atlas::COLS, Atlas::ROWS);
+	}
+	printf("Texture atlas loaded from %s in %.2f ms\n", textureSource,
+		std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - textureStart).count());
 	if (!textureLoaded) {
 		std::cerr << "Failed to load texture atlas" << std::endl;
 		return false;
 	}
 	
-	// Set the texture uniform in the default shader
+	// The chunk programs sample the atlas from unit 1 (layout binding)
 	textureAtlas.bind(1);
-	shader->bind();
-	shader->setUniform1i("uTextureArray", 1);
 
     
 	// Backface culling
@@ -124,21 +159,42 @@ void Renderer::shutdown()
 	glfwDestroyWindow(window);
 }
 
+void Renderer::reportShaderStartup(const std::vector<const Shader*>& programs) const
+{
+	// One line per program, then the totals, so startup time can be compared across runs
+	double cachedMs = 0.0, compiledMs = 0.0;
+	int cached = 0;
+	printf("Shader startup report\n");
+	for (const Shader* program : programs) {
+		std::string name = std::filesystem::path(program->getVertexFilePath()).filename().string() + " + " +
+			std::filesystem::path(program->getFragmentFilePath()).filename().string();
+		printf("  %-40s %-8s %8.2f ms\n", name.c_str(), program->isLoadedFromCache() ? "cached" : "compiled", program->getLoadTimeMs());
+		if (program->isLoadedFromCache()) {
+			cachedMs += program->getLoadTimeMs();
+			cached++;
+		}
+		else {
+			compiledMs += program->getLoadTimeMs();
+		}
+	}
+	printf("  %d cached in %.2f ms, %d compiled in %.2f ms\n", cached, cachedMs, int(programs.size()) - cached, compiledMs);
+}
+
+uint32_t Renderer::getChunkShaderFeatures() const
+{
+	uint32_t features = 0;
+	if (world->useAmbientOcclusion) features |= ChunkAmbientOcclusion;
+	if (world->getPlayer()->wireframeMode) features |= ChunkWireframe;
+	return features;
+}
+
 void Renderer::renderSky()
 {
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDepthFunc(GL_LEQUAL);
+	// Colors and sun direction come from the frame uniforms
 	skyShader->bind();
-	skyShader->setUniformMat4f("uView", glm::mat3(world->getPlayer()->getView())); // Use mat3 to ignore translation
-	skyShader->setUniformMat4f("uProjection", world->getPlayer()->getProjection());
-	skyShader->setUniformVec3f("uHorizonColor", world->getSkyColor().horizon);
-	skyShader->setUniformVec3f("uZenithColor", world->getSkyColor().zenith);
-	skyShader->setUniformVec3f("uSunDir", world->getSunDir());
-	skyShader->setUniform3f("uSunColor", 1.0f, 0.96f, 0.85f);
-	skyShader->setUniform1f("uSunAngularRadius", 0.035f); 
-	skyShader->setUniform1f("uSunSoftness", 0.015f);    
-	skyShader->setUniform1f("uSunIntensity", 1.0f);   
 	skybox->draw();
 	glDepthFunc(GL_LESS);
 	glDisable(GL_BLEND);
@@ -152,37 +208,103 @@ void Renderer::render()
 
 	glClearColor(world->getSkyColor().horizon.x, world->getSkyColor().horizon.y, world->getSkyColor().horizon.z, 1.0f);
 
-	// Default shader uniforms
-	shader->bind();
-	shader->setUniformMat4f("uView", world->getPlayer()->getView());
-	shader->setUniformMat4f("uProjection", world->getPlayer()->getProjection());
-	shader->setUniform1f("uLightIntensity", world->getLightIntensity());
+	// Values shared by every shader this frame, one upload
+	FrameUniformData frame;
+	frame.view = world->getPlayer()->getView();
+	frame.projection = world->getPlayer()->getProjection();
+	frame.sunDirection = glm::vec4(world->getSunDir(), 0.0f);
+	frame.horizonColor = glm::vec4(world->getSkyColor().horizon, 1.0f);
+	frame.zenithColor = glm::vec4(world->getSkyColor().zenith, 1.0f);
+	frame.lightIntensity = world->getLightIntensity();
+	m_frameUniforms.update(frame);
+
+	// Chunk program specialized for the current settings
+	m_chunkShaders->get(getChunkShaderFeatures()).bind();
+
+	// Draw the world chunks, skipping face directions that point away from the camera
+	glm::vec3 eye = world->getPlayer()->getCameraPosition();
+	size_t drawnQuads = 0;
+	size_t totalQuads = 0;
+	m_chunkDrawCalls = 0;
+
+	glm::mat4 viewProjection = frame.projection * frame.view;
+	const auto& renderQueue = world->getRenderQueue();
+
+	// Occlusion culling uses last frame's job and queues the next one, the worker runs alongside
+	// the rest of the frame
+	collectOcclusionResults(eye);
+	bool occlusionCulling = world->useOcclusionCulling;
+	if (occlusionCulling) {
+		startOcclusionCulling(viewProjection, eye);
+	}
+	m_lastEye = eye;
 
-	// Draw the world chunks
-	// Opaque chunks
-	for (auto& chunk : world->getRenderList())
+	// Frustum culling against the chunk boxes, tightened to their occupied height.
+	// The render queue is sorted nearest first, so the visible list is too.
+	Frustum frustum(viewProjection);
+	m_visibleChunks.clear();
+	m_visibleIndices.clear();
+	m_chunksCulled = 0;
+	m_chunksUnreachable = 0;
+
+	// Chunks in the frustum that no open path from the camera chunk leads to are skipped as well
+	bool connectivityCulling = world->useConnectivityCulling && m_visibilityGraph.findReachable(*world, eye, frustum, m_reachableChunks);
+
+	for (size_t i = 0; i < renderQueue.size(); ++i)
 	{
-		if (chunk)
-		{
-			shader->setUniformMat4f("uModel", glm::translate(glm::mat4(1.0f), chunk->getWorldPosition()));
-			chunk->draw();
+		Chunk* chunk = renderQueue[i].chunk;
+		totalQuads += chunk->getQuadCount();
+		if (chunk->isEmpty() || !frustum.isBoxVisible(chunk->getBoundsMin(), chunk->getBoundsMax())) {
+			m_chunksCulled++;
+		}
+		else if (connectivityCulling && !m_reachableChunks.count(chunk)) {
+			m_chunksUnreachable++;
+		}
+		else {
+			m_visibleIndices.push_back(i);
 		}
 	}
 
-
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	// Transparent chunks
-	for (auto& chunk : world->getRenderList())
+	m_chunksOccluded = 0;
+	for (size_t i : m_visibleIndices)
 	{
-		if (chunk)
+		Chunk* chunk = renderQueue[i].chunk;
+		if (occlusionCulling && m_occludedChunks.count(chunk->getPositionGrid())) {
+			m_chunksOccluded++;
+			continue;
+		}
+		m_visibleChunks.push_back(chunk);
+	}
+
+	if (world->useIndirectDraw) {
+		renderChunksIndirect(eye, drawnQuads);
+	}
+	else {
+		// Opaque chunks, front to back so the depth test rejects hidden terrain early.
+		// Each draw places its chunk through the origin attribute value.
+		for (Chunk* chunk : m_visibleChunks)
 		{
-			shader->setUniformMat4f("uModel", glm::translate(glm::mat4(1.0f), chunk->getWorldPosition()));
+			size_t quads = chunk->draw(chunk->getVisibleFaces(eye));
+			drawnQuads += quads;
+			m_chunkDrawCalls += quads > 0;
+		}
+
 
-			chunk->drawTransparent();
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		// Transparent chunks, back to front so water blends over what is behind it
+		for (auto it = m_visibleChunks.rbegin(); it != m_visibleChunks.rend(); ++it)
+		{
+			Chunk* chunk = *it;
+			size_t quads = chunk->drawTransparent(chunk->getVisibleFaces(eye));
+			drawnQuads += quads;
+			m_chunkDrawCalls += quads > 0;
 		}
+		glDisable(GL_BLEND);
 	}
-	glDisable(GL_BLEND);
+
+	m_chunkTriangles = drawnQuads * 2;
+	m_chunkTrianglesTotal = totalQuads * 2;
 
 	// Draw Sky
 	renderSky();
@@ -198,11 +320,10 @@ void Renderer::render()
 
 		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 
-		shader->bind();
-		shader->setUniformMat4f("uModel", glm::scale(glm::translate(glm::mat4(1.0f), world->getPlayer()->getBlockPosition()), glm::vec3(1.01f, 1.01f, 1.01f)));
-		shader->setUniformBool("uColorBlock", true);
+		// The chunk shader reads packed chunk vertices, the stencil cube goes through the highlight shader
+		highlightShader->bind();
+		highlightShader->setUniformMat4f(m_highlightModel, glm::scale(glm::translate(glm::mat4(1.0f), world->getPlayer()->getBlockPosition()), glm::vec3(1.01f, 1.01f, 1.01f)));
 		cubeMesh->draw();
-		shader->setUniformBool("uColorBlock", false);
 
 		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
@@ -211,10 +332,7 @@ void Renderer::render()
 		glDepthMask(GL_FALSE);
 		glLineWidth(3);
 
-		highlightShader->bind();
-		highlightShader->setUniformMat4f("uView", world->getPlayer()->getView());
-		highlightShader->setUniformMat4f("uProjection", world->getPlayer()->getProjection());
-		highlightShader->setUniformMat4f("uModel", glm::scale(glm::translate(glm::mat4(1.0f), world->getPlayer()->getBlockPosition()), glm::vec3(1.025f, 1.025f, 1.025f)));
+		highlightShader->setUniformMat4f(m_highlightModel, glm::scale(glm::translate(glm::mat4(1.0f), world->getPlayer()->getBlockPosition()), glm::vec3(1.025f, 1.025f, 1.025f)));
 		cubeMesh->draw();
 
 		glDisable(GL_POLYGON_OFFSET_FILL);
@@ -239,6 +357,125 @@ void Renderer::render()
 	}
 }
 
+void Renderer::startOcclusionCulling(const glm::mat4& viewProjection, const glm::vec3& eye)
+{
+	// Room for the eye to move until the results are used, twice this frame's motion.
+	// A ray from the padded eye to a candidate, moved back to the job's eye, lands in the grown
+	// candidate and misses the shrunk occluders only if the original ray missed the real ones.
+	float padding = std::max(OCCLUSION_MIN_PADDING, 2.0f * glm::length(eye - m_lastEye));
+	padding = std::min(padding, float(Chunk::OCCLUDER_TILE_SIZE));
+	glm::vec3 pad(padding);
+
+	// Every chunk of the render queue is tested
+	m_occluders.clear();
+	m_occlusionCandidates.clear();
+	m_occlusionChunks.clear();
+	const auto& renderQueue = world->getRenderQueue();
+	glm::ivec3 gridMin(INT_MAX), gridMax(INT_MIN);
+	for (size_t i = 0; i < renderQueue.size(); ++i)
+	{
+		const Chunk* chunk = renderQueue[i].chunk;
+		m_occlusionCandidates.push_back({ chunk->getBoundsMin() - pad, chunk->getBoundsMax() + pad });
+		m_occlusionChunks.push_back(chunk->getPositionGrid());
+
+		if (i < OCCLUDER_CHUNKS) {
+			gridMin = glm::min(gridMin, chunk->getPositionGrid());
+			gridMax = glm::max(gridMax, chunk->getPositionGrid());
+		}
+	}
+
+	// The solid tiles of the chunks around the nearest ones occlude, shrunk as one terrain surface.
+	// The grid has a ring of tiles from the chunks beyond for the neighbor heights.
+	if (!renderQueue.empty()) {
+		const int tiles = Chunk::OCCLUDER_TILES;
+		int columns = (gridMax.x - gridMin.x + 1) * tiles + 2;
+		int rows = (gridMax.z - gridMin.z + 1) * tiles + 2;
+		m_occluderHeights.assign(size_t(columns) * rows, 0);
+
+		auto& chunks = world->getChunks();
+		for (int row = 0; row < rows; ++row) {
+			for (int column = 0; column < columns; ++column) {
+				// Tile coordinates relative to the grid chunk, the ring falls in the neighbors
+				int tx = gridMin.x * tiles + column - 1;
+				int tz = gridMin.z * tiles + row - 1;
+				int cx = tx >= 0 ? tx / tiles : (tx - tiles + 1) / tiles;
+				int cz = tz >= 0 ? tz / tiles : (tz - tiles + 1) / tiles;
+				auto it = chunks.find(glm::ivec3(cx, 0, cz));
+				if (it != chunks.end()) {
+					m_occluderHeights[size_t(row) * columns + column] = it->second->getOccluderHeight(tx - cx * tiles, tz - cz * tiles);
+				}
+			}
+		}
+
+		const float tileSize = float(Chunk::OCCLUDER_TILE_SIZE);
+		glm::vec3 origin(gridMin.x * Chunk::CHUNK_SIZE - tileSize, 0.0f, gridMin.z * Chunk::CHUNK_SIZE - tileSize);
+		OcclusionCuller::addColumnOccluders(m_occluderHeights, columns, rows, origin, tileSize, padding, m_occluders);
+	}
+
+	// Candidates straddling the screen edge may be hidden only in their off-screen part
+	m_occlusionCuller.partialBoxesVisible = true;
+	m_occlusionCuller.cullAsync(viewProjection, eye, m_occluders, m_occlusionCandidates);
+	m_occlusionPending = true;
+	m_occlusionEye = eye;
+	m_occlusionPadding = padding;
+}
+
+void Renderer::collectOcclusionResults(const glm::vec3& eye)
+{
+	m_occludedChunks.clear();
+	m_occlusionWaitMs = 0.0f;
+	if (!m_occlusionPending) {
+		return;
+	}
+
+	auto waitStart = std::chrono::steady_clock::now();
+	const std::vector<uint8_t>& results = m_occlusionCuller.waitResults();
+	m_occlusionWaitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+	m_occlusionPending = false;
+
+	// Past the padding nothing is known to be hidden, every chunk is drawn this frame
+	if (glm::length(eye - m_occlusionEye) > m_occlusionPadding) {
+		return;
+	}
+	for (size_t i = 0; i < results.size() && i < m_occlusionChunks.size(); ++i) {
+		if (!results[i]) {
+			m_occludedChunks.insert(m_occlusionChunks[i]);
+		}
+	}
+}
+
+void Renderer::renderChunksIndirect(const glm::vec3& eye, size_t& drawnQuads)
+{
+	ChunkArena& arena = world->getMeshArena();
+
+	// One origin per chunk, shared by both passes through the baseInstance of their commands
+	m_chunkOrigins.clear();
+	m_opaqueCommands.clear();
+	m_transparentCommands.clear();
+	// Commands run in order: opaque front to back, transparent back to front
+	for (Chunk* chunk : m_visibleChunks)
+	{
+		uint32_t instance = uint32_t(m_chunkOrigins.size());
+		m_chunkOrigins.push_back(glm::ivec4(glm::ivec3(chunk->getWorldPosition()), 0));
+		drawnQuads += chunk->appendDrawCommands(chunk->getVisibleFaces(eye), instance, m_opaqueCommands);
+	}
+	for (size_t i = m_visibleChunks.size(); i-- > 0;)
+	{
+		Chunk* chunk = m_visibleChunks[i];
+		drawnQuads += chunk->appendTransparentDrawCommands(chunk->getVisibleFaces(eye), uint32_t(i), m_transparentCommands);
+	}
+	arena.setDrawOrigins(m_chunkOrigins);
+
+	// Opaque chunks
+	m_chunkDrawCalls += arena.drawIndirect(m_opaqueCommands);
+
+	// Transparent chunks
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	m_chunkDrawCalls += arena.drawIndirect(m_transparentCommands);
+	glDisable(GL_BLEND);
+}
+
 void Renderer::renderUI()
 {
 	ImGui::Render();
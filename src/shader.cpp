@@ -6,12 +6,17 @@
 #include <sstream>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <climits>
+#include <chrono>
+#include <filesystem>
 #include <glm/gtc/type_ptr.hpp>
 
-Shader::Shader(const std::string& vertexFilePath, const std::string& fragmentFilePath)
-    : m_vertexFilePath(vertexFilePath), m_fragmentFilePath(fragmentFilePath), m_shaderID(0)
+Shader::Shader(const std::string& vertexFilePath, const std::string& fragmentFilePath, const std::vector<std::string>& defines)
+    : m_vertexFilePath(vertexFilePath), m_fragmentFilePath(fragmentFilePath), m_defines(defines), m_shaderID(0)
 {
     m_shaderID = compile();
+    collectUniforms();
     bind();
 }
 
@@ -20,41 +25,96 @@ Shader::~Shader()
     glDeleteProgram(m_shaderID);
 }
 
+bool Shader::loadSource(const std::string& filePath, std::string& source, int depth)
+{
+    if (depth > MAX_INCLUDE_DEPTH) {
+        std::cerr << "Shader includes nested too deep in " << filePath << std::endl;
+        return false;
+    }
+
+    std::ifstream stream(filePath, std::ios::in);
+    if (!stream.is_open()) {
+        printf("Impossible to open %s.\n", filePath.c_str());
+        return false;
+    }
+
+    // Includes are resolved relative to the including file
+    std::string directory = filePath.substr(0, filePath.find_last_of("/\\") + 1);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(stream, line)) {
+        ++lineNumber;
+        if (lineNumber == 1 && line.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+            line.erase(0, 3);
+        }
+
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0) {
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos) {
+                std::cerr << filePath << ":" << lineNumber << ": malformed #include" << std::endl;
+                return false;
+            }
+            source += "#line 1\n";
+            if (!loadSource(directory + line.substr(open + 1, close - open - 1), source, depth + 1)) {
+                return false;
+            }
+            // Keep compiler messages pointing at the right line of this file
+            source += "#line " + std::to_string(lineNumber + 1) + "\n";
+            continue;
+        }
+        source += line;
+        source += '\n';
+    }
+    return true;
+}
+
+bool Shader::preprocess(const std::string& filePath, std::string& source) const
+{
+    source.clear();
+    if (!loadSource(filePath, source, 0)) {
+        return false;
+    }
+
+    // Defines go right after #version, which has to stay the first statement
+    size_t version = source.find("#version");
+    size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version) + 1;
+
+    std::string defines;
+    for (const std::string& define : m_defines) {
+        defines += "#define " + define + "\n";
+    }
+    if (!defines.empty()) {
+        defines += "#line 2\n";
+        source.insert(insertAt, defines);
+    }
+    return true;
+}
+
 unsigned int Shader::compile() {
-    // Create the shaders
-    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+    auto start = std::chrono::steady_clock::now();
 
-    // Read the Vertex Shader code from the file
+    // Read both stages, resolving includes and adding the variant defines
     std::string VertexShaderCode;
-    std::ifstream VertexShaderStream(m_vertexFilePath, std::ios::in);
-    if (VertexShaderStream.is_open()) {
-        std::stringstream sstr;
-        sstr << VertexShaderStream.rdbuf();
-        VertexShaderCode = sstr.str();
-        VertexShaderStream.close();
-    }
-    else {
-        printf("Impossible to open %s.\n", m_vertexFilePath.c_str());
-        getchar();
+    std::string FragmentShaderCode;
+    if (!preprocess(m_vertexFilePath, VertexShaderCode) || !preprocess(m_fragmentFilePath, FragmentShaderCode)) {
         return 0;
     }
 
-    // Read the Fragment Shader code from the file
-    std::string FragmentShaderCode;
-    std::ifstream FragmentShaderStream(m_fragmentFilePath, std::ios::in);
-    if (FragmentShaderStream.is_open()) {
-        std::stringstream sstr;
-        sstr << FragmentShaderStream.rdbuf();
-        FragmentShaderCode = sstr.str();
-        FragmentShaderStream.close();
-    }
-    else {
-        printf("Impossible to open %s.\n", m_fragmentFilePath.c_str());
-        getchar();
-        return 0;
+    // A cached binary of the same sources from the same driver skips compilation
+    uint64_t sourceHash = hashSource(VertexShaderCode, FragmentShaderCode);
+    if (GLuint cached = loadProgramBinary(sourceHash)) {
+        m_loadedFromCache = true;
+        m_loadTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return cached;
     }
 
+    // Create the shaders
+    GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+    GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
     GLint Result = GL_FALSE;
     int InfoLogLength;
 
@@ -93,6 +153,9 @@ unsigned int Shader::compile() {
     GLuint ProgramID = glCreateProgram();
     glAttachShader(ProgramID, VertexShaderID);
     glAttachShader(ProgramID, FragmentShaderID);
+    if (isBinaryCacheAvailable()) {
+        glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(ProgramID);
 
     // Check the program
@@ -110,20 +173,171 @@ unsigned int Shader::compile() {
     glDeleteShader(VertexShaderID);
     glDeleteShader(FragmentShaderID);
 
+    if (Result == GL_TRUE) {
+        saveProgramBinary(ProgramID, sourceHash);
+    }
+
+    m_loadTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
     return ProgramID;
 }
 
-int Shader::getUniformLocation(const std::string& name)
+void Shader::setBinaryCacheDirectory(const std::string& directory)
 {
-    if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end())
-    {
-        return m_UniformLocationCache[name];
+    s_binaryCacheDirectory = directory;
+}
+
+bool Shader::isBinaryCacheAvailable()
+{
+    if (s_binaryCacheDirectory.empty() || !GLAD_GL_VERSION_4_1) {
+        return false;
     }
-    else {
-        int location = glGetUniformLocation(m_shaderID, name.c_str());
-        m_UniformLocationCache[name] = location;
-        return location;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+uint64_t Shader::hashSource(const std::string& vertexSource, const std::string& fragmentSource)
+{
+    // FNV-1a over both stages, with a separator so moving text between them changes the hash
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const std::string& text) {
+        for (char c : text) {
+            hash = (hash ^ uint8_t(c)) * 1099511628211ull;
+        }
+        hash = (hash ^ 0xFFu) * 1099511628211ull;
+    };
+    add(vertexSource);
+    add(fragmentSource);
+    return hash;
+}
+
+std::string Shader::getDriverString()
+{
+    // Binaries are only valid for the driver that produced them
+    auto get = [](GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+    };
+    return get(GL_VENDOR) + "|" + get(GL_RENDERER) + "|" + get(GL_VERSION);
+}
+
+std::string Shader::getBinaryCachePath(uint64_t sourceHash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)sourceHash);
+    return (std::filesystem::path(s_binaryCacheDirectory) / name).string();
+}
+
+unsigned int Shader::loadProgramBinary(uint64_t sourceHash)
+{
+    if (!isBinaryCacheAvailable()) {
+        return 0;
+    }
+
+    std::ifstream file(getBinaryCachePath(sourceHash), std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+
+    BinaryCacheHeader header{};
+    std::string driver = getDriverString();
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != BinaryCacheHeader::MAGIC ||
+        header.sourceHash != sourceHash || header.driverLength != driver.size()) {
+        return 0;
     }
+
+    std::string cachedDriver(header.driverLength, '\0');
+    std::vector<char> binary(header.binaryLength);
+    if (!file.read(cachedDriver.data(), cachedDriver.size()) || cachedDriver != driver ||
+        !file.read(binary.data(), binary.size())) {
+        return 0;
+    }
+
+    // The driver may still reject the binary, e.g. after an update keeping the same version string
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void Shader::saveProgramBinary(unsigned int program, uint64_t sourceHash)
+{
+    if (!isBinaryCacheAvailable()) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(s_binaryCacheDirectory, error);
+
+    std::string driver = getDriverString();
+    BinaryCacheHeader header{ sourceHash, BinaryCacheHeader::MAGIC, uint32_t(driver.size()), uint32_t(format), uint32_t(length) };
+    std::ofstream file(getBinaryCachePath(sourceHash), std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Warning: cannot write shader cache in " << s_binaryCacheDirectory << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(driver.data(), driver.size());
+    file.write(binary.data(), binary.size());
+}
+
+void Shader::collectUniforms()
+{
+    m_uniforms.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_shaderID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<char> nameBuffer(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_shaderID, GLuint(i), GLsizei(nameBuffer.size()), &length, &size, &type, nameBuffer.data());
+
+        // Block members have no location, arrays are reported as name[0]
+        int location = glGetUniformLocation(m_shaderID, nameBuffer.data());
+        if (location == -1) continue;
+        std::string_view name(nameBuffer.data(), length);
+        if (name.ends_with("[0]")) {
+            name.remove_suffix(3);
+        }
+        m_uniforms.push_back({ hashUniformName(name), location });
+    }
+    std::sort(m_uniforms.begin(), m_uniforms.end());
+
+    for (size_t i = 1; i < m_uniforms.size(); ++i) {
+        if (m_uniforms[i].first == m_uniforms[i - 1].first) {
+            std::cerr << "Warning: uniform name hash collision in " << m_vertexFilePath << std::endl;
+        }
+    }
+}
+
+UniformHandle Shader::getUniform(UniformName name) const
+{
+    auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), std::make_pair(name.hash, INT_MIN));
+    if (it != m_uniforms.end() && it->first == name.hash) {
+        return UniformHandle{ it->second };
+    }
+    std::cerr << "Warning: Uniform '" << name.name << "' not found in " << m_vertexFilePath << " / " << m_fragmentFilePath << std::endl;
+    return UniformHandle{};
 }
 
 void Shader::bind() const
@@ -136,92 +350,52 @@ void Shader::unbind() const
     glUseProgram(0);
 }
 
-void Shader::setUniform1f(const std::string& name, float value)
+void Shader::setUniform1i(UniformHandle handle, int value)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform1f(location, value);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform1i(handle.location, value);
 }
 
-void Shader::setUniform2f(const std::string& name, float v0, float v1)
+void Shader::setUniform1f(UniformHandle handle, float value)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform2f(location, v0, v1);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform1f(handle.location, value);
 }
 
-void Shader::setUniform3f(const std::string& name, float v0, float v1, float v2)
+void Shader::setUniform2f(UniformHandle handle, float v0, float v1)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform3f(location, v0, v1, v2);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform2f(handle.location, v0, v1);
 }
 
-void Shader::setUniform4f(const std::string& name, float v0, float v1, float v2, float v3)
+void Shader::setUniform3f(UniformHandle handle, float v0, float v1, float v2)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform4f(location, v0, v1, v2, v3);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform3f(handle.location, v0, v1, v2);
 }
 
-void Shader::setUniformMat3f(const std::string& name, const glm::mat3& matrix)
+void Shader::setUniform4f(UniformHandle handle, float v0, float v1, float v2, float v3)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniformMatrix3fv(location, 1, GL_FALSE, &matrix[0][0]);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform4f(handle.location, v0, v1, v2, v3);
 }
 
-void Shader::setUniform1i(const std::string& name, int value)
+void Shader::setUniformMat3f(UniformHandle handle, const glm::mat3& matrix)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform1i(location, value);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniformMatrix3fv(handle.location, 1, GL_FALSE, &matrix[0][0]);
 }
 
-void Shader::setUniformMat4f(const std::string& name, const glm::mat4& matrix)
+void Shader::setUniformMat4f(UniformHandle handle, const glm::mat4& matrix)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniformMatrix4fv(handle.location, 1, GL_FALSE, &matrix[0][0]);
 }
 
-void Shader::setUniformVec3f(const std::string& name, const glm::vec3& vector)
+void Shader::setUniformVec3f(UniformHandle handle, const glm::vec3& vector)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform3fv(location, 1, &vector[0]);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform3fv(handle.location, 1, &vector[0]);
 }
 
-void Shader::setUniformBool(const std::string& name, bool value)
+void Shader::setUniformBool(UniformHandle handle, bool value)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform1i(location, value);
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
+    glUniform1i(handle.location, value);
 }
 
-void Shader::setUniform3fv(const std::string& name, const std::vector<glm::vec3> vector, int count)
+void Shader::setUniform3fv(UniformHandle handle, const std::vector<glm::vec3>& vector, int count)
 {
-    int location = getUniformLocation(name);
-    if (location != -1)
-        glUniform3fv(location, count, glm::value_ptr(vector[0]));
-    else
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader." << std::endl;
-}
\ No newline at end of file
+    glUniform3fv(handle.location, count, glm::value_ptr(vector[0]));
+}
@@ -0,0 +1,30 @@
+#include "shader_variants.h"
+#include <iostream>
+
+ShaderVariants::ShaderVariants(const std::string& vertexFilePath, const std::string& fragmentFilePath, const std::vector<std::string>& features)
+	: m_vertexFilePath(vertexFilePath), m_fragmentFilePath(fragmentFilePath), m_features(features)
+{
+}
+
+Shader& ShaderVariants::get(uint32_t featureBits)
+{
+	auto it = m_programs.find(featureBits);
+	if (it != m_programs.end()) {
+		return *it->second;
+	}
+
+	std::vector<std::string> defines;
+	for (size_t i = 0; i < m_features.size(); ++i) {
+		if ((featureBits >> i) & 1) {
+			defines.push_back(m_features[i]);
+		}
+	}
+	if (featureBits >> m_features.size()) {
+		std::cerr << "Warning: unknown shader feature bits " << featureBits << " for " << m_vertexFilePath << std::endl;
+	}
+
+	auto shader = std::make_unique<Shader>(m_vertexFilePath, m_fragmentFilePath, defines);
+	Shader& program = *shader;
+	m_programs.emplace(featureBits, std::move(shader));
+	return program;
+}
@@ -0,0 +1,102 @@
+// The implementation is compiled here, before terrain_generator.h includes the declarations only
+#define FNL_IMPL
+#include "FastNoiseLite.h"
+#include "terrain_generator.h"
+#include "chunk.h"
+#include <algorithm>
+
+TerrainGenerator::TerrainGenerator(int seed) : m_seed(seed), m_heightNoise(seed, 0.015f)
+{
+	m_treeNoise = fnlCreateState();
+	m_treeNoise.seed = seed;
+	m_treeNoise.noise_type = FNL_NOISE_OPENSIMPLEX2S;
+	m_treeNoise.frequency = 0.5f;
+}
+
+void TerrainGenerator::generate(const glm::ivec3& chunkCoord, Chunk& out) const
+{
+	const int size = Chunk::CHUNK_SIZE;
+	const int height = Chunk::CHUNK_HEIGHT;
+	int originX = chunkCoord.x * size;
+	int originZ = chunkCoord.z * size;
+
+	// Heights of the whole chunk in one batch, indexed z * size + x
+	float heights[Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE];
+	m_heightNoise.sampleGrid(originX, originZ, size, size, heights);
+
+	// FastNoiseLite takes a mutable state it only reads, sample through a local copy
+	fnl_state treeNoise = m_treeNoise;
+
+	for (int x = 0; x < size; ++x) {
+		for (int z = 0; z < size; ++z) {
+			float noiseValue = heights[z * size + x];
+			int maxHeight = static_cast<int>((noiseValue + 1.0f) * (height / 2));
+
+			for (int y = 0; y < height; ++y) {
+				BlockType type = BlockType::None;
+				if (y < maxHeight) {
+					if (y < maxHeight - 4) {
+						type = BlockType::Stone;
+					}
+					else if (y == maxHeight - 1) {
+						type = maxHeight <= Chunk::WATER_HEIGHT ? BlockType::Sand : BlockType::Grass;
+					}
+					else {
+						type = BlockType::Dirt;
+					}
+				}
+				// Add water blocks if maxHeight is below WATER_HEIGHT
+				if (type == BlockType::None && y < Chunk::WATER_HEIGHT) {
+					type = BlockType::Water;
+				}
+				out.setBlock(x, y, z, type);
+			}
+		}
+	}
+
+	// Trees on grass, kept away from the chunk border so their leaves stay inside
+	for (int x = 2; x < size - 2; ++x) {
+		for (int z = 2; z < size - 2; ++z) {
+			float tn = fnlGetNoise2D(&treeNoise, originX + x, originZ + z);
+			int surfaceY = std::max(out.getColumnHeight(x, z) - 1, 0);
+			if (tn > 0.8f && out.getBlock(x, surfaceY, z) == BlockType::Grass) {
+				plantTree(out, x, surfaceY + 1, z);
+			}
+		}
+	}
+}
+
+void TerrainGenerator::plantTree(Chunk& chunk, int x, int y, int z)
+{
+	const int size = Chunk::CHUNK_SIZE;
+	const int height = Chunk::CHUNK_HEIGHT;
+
+	// Trunk
+	for (int i = 0; i < 3; ++i) {
+		if (y + i < height) {
+			chunk.setBlock(x, y + i, z, BlockType::Tree);
+		}
+	}
+
+	// Leaves
+	int leafStartY = y + 2;
+	int leafLayers = 2;
+	int baseRadius = 2;
+
+	for (int i = 0; i < leafLayers; ++i) {
+		int dy = leafStartY + i;
+		int radius = std::max(baseRadius - i, 0);
+
+		for (int dx = -radius; dx <= radius; ++dx) {
+			for (int dz = -radius; dz <= radius; ++dz) {
+				int nx = x + dx;
+				int nz = z + dz;
+				if (dx * dx + dz * dz <= radius * radius && nx >= 0 && nx < size && nz >= 0 && nz < size && dy < height) {
+					if (chunk.getBlock(nx, dy, nz) != BlockType::Tree) {
+						chunk.setBlock(nx, dy, nz, BlockType::Leaves);
+					}
+				}
+			}
+		}
+	}
+}
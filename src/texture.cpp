@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <iostream>
 #include <cassert>
+#include "texture_pack.h"
+#include "mapped_file.h"
 
 Texture::Texture()
 {
@@ -102,6 +104,46 @@ bool Texture::loadTextureArrayFromFile(const char* filePath,
 
     stbi_image_free(atlasData);
     glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    m_layerCount = layerCount;
+    return true;
+}
+
+bool Texture::loadTextureArrayFromPack(const char* filePath)
+{
+    // The pack is mapped, not read: layers and mip levels are uploaded straight from the file pages
+    MappedFile file;
+    if (!file.open(filePath)) {
+        return false;
+    }
+
+    const TexturePackHeader* header;
+    const TexturePackLevel* levels;
+    std::string error;
+    if (!TexturePack::parse(file.data(), file.size(), header, levels, error)) {
+        std::cerr << "Invalid texture pack " << filePath << ": " << error << "\n";
+        return false;
+    }
+
+    glGenTextures(1, &m_textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureID);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, header->mipLevels, GL_RGBA8, header->layerWidth, header->layerHeight, header->layerCount);
+
+    // One call per mip level covers every layer
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t level = 0; level < header->mipLevels; ++level) {
+        const TexturePackLevel& l = levels[level];
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, l.width, l.height, header->layerCount,
+            GL_RGBA, GL_UNSIGNED_BYTE, file.data() + l.offset);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    m_layerCount = int(header->layerCount);
     return true;
 }
 
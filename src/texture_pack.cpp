@@ -0,0 +1,107 @@
+#include "texture_pack.h"
+#include <algorithm>
+#include <cstring>
+
+bool TexturePack::build(const uint8_t* atlas, int atlasWidth, int atlasHeight, int cols, int rows, std::vector<uint8_t>& pack, std::string& error)
+{
+	if (cols <= 0 || rows <= 0 || atlasWidth % cols != 0 || atlasHeight % rows != 0) {
+		error = "atlas size " + std::to_string(atlasWidth) + "x" + std::to_string(atlasHeight) +
+			" not divisible by " + std::to_string(cols) + "x" + std::to_string(rows);
+		return false;
+	}
+
+	TexturePackHeader header{};
+	header.magic = TexturePackHeader::MAGIC;
+	header.version = TexturePackHeader::VERSION;
+	header.layerWidth = uint32_t(atlasWidth / cols);
+	header.layerHeight = uint32_t(atlasHeight / rows);
+	header.layerCount = uint32_t(cols * rows);
+
+	// Full chain down to 1x1, same count as the runtime path allocated with glTexStorage3D
+	uint32_t largest = std::max(header.layerWidth, header.layerHeight);
+	header.mipLevels = 1;
+	while ((largest >> header.mipLevels) > 0 && header.mipLevels < MAX_LEVELS) {
+		header.mipLevels++;
+	}
+
+	std::vector<TexturePackLevel> levels(header.mipLevels);
+	uint64_t offset = sizeof(TexturePackHeader) + levels.size() * sizeof(TexturePackLevel);
+	for (uint32_t level = 0; level < header.mipLevels; ++level) {
+		TexturePackLevel& l = levels[level];
+		l.width = std::max(1u, header.layerWidth >> level);
+		l.height = std::max(1u, header.layerHeight >> level);
+		l.size = uint64_t(l.width) * l.height * 4 * header.layerCount;
+		l.offset = offset;
+		offset += l.size;
+	}
+
+	pack.assign(size_t(offset), 0);
+	memcpy(pack.data(), &header, sizeof(header));
+	memcpy(pack.data() + sizeof(header), levels.data(), levels.size() * sizeof(TexturePackLevel));
+
+	// Level 0: slice the atlas cells into layers
+	size_t tileRow = size_t(header.layerWidth) * 4;
+	uint8_t* base = pack.data() + levels[0].offset;
+	for (int row = 0; row < rows; ++row) {
+		for (int col = 0; col < cols; ++col) {
+			uint8_t* layer = base + size_t(row * cols + col) * tileRow * header.layerHeight;
+			for (uint32_t y = 0; y < header.layerHeight; ++y) {
+				const uint8_t* src = atlas + ((size_t(row) * header.layerHeight + y) * atlasWidth + size_t(col) * header.layerWidth) * 4;
+				memcpy(layer + y * tileRow, src, tileRow);
+			}
+		}
+	}
+
+	// Each level averages 2x2 texels of the previous one, clamped at odd edges
+	for (uint32_t level = 1; level < header.mipLevels; ++level) {
+		const TexturePackLevel& src = levels[level - 1];
+		const TexturePackLevel& dst = levels[level];
+		size_t srcLayerBytes = size_t(src.width) * src.height * 4;
+		size_t dstLayerBytes = size_t(dst.width) * dst.height * 4;
+
+		for (uint32_t layer = 0; layer < header.layerCount; ++layer) {
+			const uint8_t* in = pack.data() + src.offset + layer * srcLayerBytes;
+			uint8_t* out = pack.data() + dst.offset + layer * dstLayerBytes;
+			for (uint32_t y = 0; y < dst.height; ++y) {
+				uint32_t y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+				for (uint32_t x = 0; x < dst.width; ++x) {
+					uint32_t x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+					for (int c = 0; c < 4; ++c) {
+						int sum = in[(y0 * src.width + x0) * 4 + c] + in[(y0 * src.width + x1) * 4 + c] +
+							in[(y1 * src.width + x0) * 4 + c] + in[(y1 * src.width + x1) * 4 + c];
+						out[(y * dst.width + x) * 4 + c] = uint8_t((sum + 2) / 4);
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool TexturePack::parse(const uint8_t* data, size_t size, const TexturePackHeader*& header, const TexturePackLevel*& levels, std::string& error)
+{
+	if (size < sizeof(TexturePackHeader)) {
+		error = "file too small";
+		return false;
+	}
+	header = reinterpret_cast<const TexturePackHeader*>(data);
+	if (header->magic != TexturePackHeader::MAGIC || header->version != TexturePackHeader::VERSION) {
+		error = "not a texture pack or wrong version";
+		return false;
+	}
+	if (header->mipLevels == 0 || header->mipLevels > MAX_LEVELS || header->layerCount == 0 ||
+		size < sizeof(TexturePackHeader) + header->mipLevels * sizeof(TexturePackLevel)) {
+		error = "bad header";
+		return false;
+	}
+
+	levels = reinterpret_cast<const TexturePackLevel*>(data + sizeof(TexturePackHeader));
+	for (uint32_t level = 0; level < header->mipLevels; ++level) {
+		const TexturePackLevel& l = levels[level];
+		if (l.size != uint64_t(l.width) * l.height * 4 * header->layerCount || l.offset > size || l.size > size - l.offset) {
+			error = "bad level " + std::to_string(level);
+			return false;
+		}
+	}
+	return true;
+}
@@ -1,9 +1,14 @@
 #include "thread.h"
 
+namespace {
+    thread_local int t_workerIndex = -1;
+}
+
 ThreadPool::ThreadPool(size_t numThreads) : stop(false)
 {
     for (size_t i = 0; i < numThreads; ++i) {
-        workers.emplace_back([this] {
+        workers.emplace_back([this, i] {
+            t_workerIndex = int(i);
             while (true) {
                 std::function<void()> task;
                 {   
@@ -13,7 +18,7 @@ ThreadPool::ThreadPool(size_t numThreads) : stop(false)
                     if (this->stop && this->tasks.empty())
                         return;
                     task = std::move(this->tasks.front());
-                    this->tasks.pop();
+                    this->tasks.pop_front();
                 }
                 task(); 
             }
@@ -22,20 +27,37 @@ ThreadPool::ThreadPool(size_t numThreads) : stop(false)
 }
 
 ThreadPool::~ThreadPool()
+{
+    join();
+}
+
+void ThreadPool::join()
 {
     {   
         std::unique_lock<std::mutex> lock(queueMutex);
         stop = true;
     }
     condition.notify_all();
-    for (auto& t : workers) t.join();
+    for (auto& t : workers) {
+        if (t.joinable()) t.join();
+    }
 }
 
-void ThreadPool::enqueue(std::function<void()> job)
+void ThreadPool::enqueue(std::function<void()> job, bool urgent)
 {
     {
         std::unique_lock<std::mutex> lock(queueMutex);
-        tasks.push(std::move(job));
+        if (urgent) {
+            tasks.push_front(std::move(job));
+        }
+        else {
+            tasks.push_back(std::move(job));
+        }
     }
     condition.notify_one();
 }
+
+int ThreadPool::workerIndex()
+{
+    return t_workerIndex;
+}
@@ -0,0 +1,151 @@
+#include "visibility_graph.h"
+#include "chunk_snapshot.h"
+#include "mesh_scratch.h"
+#include "frustum.h"
+#include "world.h"
+#include <bit>
+#include <algorithm>
+
+namespace {
+
+	// Horizontal face directions, chunks are not stacked vertically
+	const int HORIZONTAL_FACES[4] = { 0, 1, 4, 5 };
+	const glm::ivec3 FACE_OFFSETS[6] = {
+		{-1, 0, 0}, { 1, 0, 0}, { 0,-1, 0}, { 0, 1, 0}, { 0, 0,-1}, { 0, 0, 1}
+	};
+
+	inline int oppositeFace(int face) { return face ^ 1; }
+
+	// Cells of free reachable from seed along the column, in both directions (Kogge-Stone fill)
+	inline uint64_t fillColumn(uint64_t seed, uint64_t free)
+	{
+		uint64_t up = seed, propagate = free;
+		up |= propagate & (up << 1);  propagate &= propagate << 1;
+		up |= propagate & (up << 2);  propagate &= propagate << 2;
+		up |= propagate & (up << 4);  propagate &= propagate << 4;
+		up |= propagate & (up << 8);  propagate &= propagate << 8;
+		up |= propagate & (up << 16); propagate &= propagate << 16;
+		up |= propagate & (up << 32);
+
+		uint64_t down = seed;
+		propagate = free;
+		down |= propagate & (down >> 1);  propagate &= propagate >> 1;
+		down |= propagate & (down >> 2);  propagate &= propagate >> 2;
+		down |= propagate & (down >> 4);  propagate &= propagate >> 4;
+		down |= propagate & (down >> 8);  propagate &= propagate >> 8;
+		down |= propagate & (down >> 16); propagate &= propagate >> 16;
+		down |= propagate & (down >> 32);
+
+		return up | down;
+	}
+}
+
+int VisibilityGraph::pairBit(int faceA, int faceB)
+{
+	int a = std::min(faceA, faceB);
+	int b = std::max(faceA, faceB);
+	return a * 6 - a * (a + 1) / 2 + (b - a - 1);
+}
+
+uint16_t VisibilityGraph::computeConnectivity(const ChunkSnapshot& snapshot, MeshScratch& scratch)
+{
+	const int size = Chunk::CHUNK_SIZE;
+	static_assert(Chunk::CHUNK_HEIGHT == 64, "the flood fill works on whole 64-bit columns");
+
+	// Opaque cells start out visited, so only open cells are filled
+	auto& visited = scratch.floodVisited;
+	for (int x = 0; x < size; ++x) {
+		for (int z = 0; z < size; ++z) {
+			visited[x][z] = snapshot.opaque[x + 1][z + 1];
+		}
+	}
+
+	uint16_t connectivity = 0;
+	auto& stack = scratch.floodStack;
+
+	for (int sx = 0; sx < size; ++sx) {
+		for (int sz = 0; sz < size; ++sz) {
+			while (~visited[sx][sz]) {
+				// Flood one open region column by column, bits spread vertically within a column
+				uint8_t faces = 0;
+				stack.clear();
+				stack.push_back({ sx, sz, uint64_t(1) << std::countr_zero(~visited[sx][sz]) });
+
+				while (!stack.empty()) {
+					MeshScratch::FloodStep step = stack.back();
+					stack.pop_back();
+
+					uint64_t open = ~visited[step.x][step.z];
+					uint64_t seed = step.cells & open;
+					if (!seed) continue;
+
+					uint64_t cells = fillColumn(seed, open);
+					visited[step.x][step.z] |= cells;
+
+					if (step.x == 0) faces |= 1 << 0;
+					if (step.x == size - 1) faces |= 1 << 1;
+					if (cells & 1) faces |= 1 << 2;
+					if (cells >> 63) faces |= 1 << 3;
+					if (step.z == 0) faces |= 1 << 4;
+					if (step.z == size - 1) faces |= 1 << 5;
+
+					if (step.x > 0) stack.push_back({ step.x - 1, step.z, cells });
+					if (step.x < size - 1) stack.push_back({ step.x + 1, step.z, cells });
+					if (step.z > 0) stack.push_back({ step.x, step.z - 1, cells });
+					if (step.z < size - 1) stack.push_back({ step.x, step.z + 1, cells });
+				}
+
+				for (int a = 0; a < 6; ++a) {
+					for (int b = a + 1; b < 6; ++b) {
+						if (((faces >> a) & 1) && ((faces >> b) & 1)) {
+							connectivity |= 1 << pairBit(a, b);
+						}
+					}
+				}
+			}
+		}
+	}
+	return connectivity;
+}
+
+bool VisibilityGraph::findReachable(const World& world, const glm::vec3& eye, const Frustum& frustum, std::unordered_set<const Chunk*>& reachable)
+{
+	reachable.clear();
+
+	// Walks only follow horizontal neighbors, from above or below the world sight lines enter chunks
+	// through their top or bottom faces
+	if (eye.y < 0.0f || eye.y >= float(Chunk::CHUNK_HEIGHT)) {
+		return false;
+	}
+
+	const Chunk* start = world.getChunkWorldPos(eye.x, eye.y, eye.z);
+	if (!start) {
+		return false;
+	}
+
+	m_queue.clear();
+	m_queue.push_back({ start, -1, 0 });
+	reachable.insert(start);
+
+	for (size_t next = 0; next < m_queue.size(); ++next) {
+		Step step = m_queue[next];
+		glm::vec3 origin = step.chunk->getWorldPosition();
+
+		for (int face : HORIZONTAL_FACES) {
+			// Never walk back towards the camera
+			if ((step.directions >> oppositeFace(face)) & 1) continue;
+			if (step.entryFace >= 0 && !isConnected(step.chunk->getFaceConnectivity(), step.entryFace, face)) continue;
+
+			glm::vec3 position = origin + glm::vec3(FACE_OFFSETS[face] * Chunk::CHUNK_SIZE);
+			const Chunk* neighbor = world.getChunk(int(position.x), int(position.y), int(position.z));
+			if (!neighbor || reachable.count(neighbor)) continue;
+
+			glm::vec3 max = position + glm::vec3(Chunk::CHUNK_SIZE, Chunk::CHUNK_HEIGHT, Chunk::CHUNK_SIZE);
+			if (!frustum.isBoxVisible(position, max)) continue;
+
+			reachable.insert(neighbor);
+			m_queue.push_back({ neighbor, oppositeFace(face), uint8_t(step.directions | (1 << face)) });
+		}
+	}
+	return true;
+}
@@ -1,15 +1,35 @@
 ﻿#include "world.h"
 #include "application.h"
+#include "chunk_snapshot.h"
+#include "mesh_scratch.h"
+#include "visibility_graph.h"
 #include <iostream>
+#include <chrono>
+#include <algorithm>
 
 
 
 World::World()
 {
+	for (size_t i = 0; i < WORKER_COUNT; ++i) {
+		meshScratch.push_back(std::make_unique<MeshScratch>());
+	}
 }
 
 World::~World()
 {
+	// Jobs read and write their chunk: skip the generation jobs not started, and wait for
+	// every job before any chunk is deleted
+	cancelGeneration = true;
+	meshThreadPool.join();
+
+	for (auto chunk : m_chunksLoading)
+	{
+		delete chunk.second;
+	}
+	m_chunksLoading.clear();
+	generatedChunks.clear();
+
 	for (auto chunk : m_chunks)
 	{
 		delete chunk.second; // Delete the Chunk pointer
@@ -24,7 +44,6 @@ bool World::init()
 		return false;
 	}
 
-	noise = fnlCreateState();
 	dayLength = dayDuration + 2*transitionDuration + nightDuration;
 	dayTimer = 0.0f;
 
@@ -35,6 +54,8 @@ void World::update(float deltaTime)
 {
 	loadChunks(m_player->getWorldPosition());
 
+	collectGeneratedChunks();
+
 	generateChunks();
 
 	setupChunks();
@@ -43,6 +64,8 @@ void World::update(float deltaTime)
 
 	removeChunks();
 
+	sortRenderQueue(m_player->getCameraPosition());
+
 	updateLighting(deltaTime);
 }
 
@@ -59,36 +82,73 @@ void World::loadChunks(glm::vec3 playerPosition)
 	int playerChunkZ = static_cast<int>(playerPosition.z) / Chunk::CHUNK_SIZE;
 
 
+	std::vector<glm::ivec3> missing;
 	for (int x = playerChunkX - CHUNK_LOAD_RADIUS; x < playerChunkX + CHUNK_LOAD_RADIUS; x++)
 	{
 		for (int z = playerChunkZ - CHUNK_LOAD_RADIUS; z < playerChunkZ + CHUNK_LOAD_RADIUS; z++)
 		{
 			glm::ivec3 chunkPos(x, 0, z);
-			if (m_chunks.find(chunkPos) == m_chunks.end()) {
-				Chunk* chunk = new Chunk(x, 0, z, this);
-				chunk->load();
-				m_chunks[chunkPos] = chunk;
-				m_chunksToGenerate.insert(chunk);
-
-				// Update neighboring chunks
-				std::vector<glm::ivec3> neighborsPos = {
-					glm::ivec3(x - 1, 0, z),
-					glm::ivec3(x + 1, 0, z),
-					glm::ivec3(x, 0, z - 1),
-					glm::ivec3(x, 0, z + 1)
-				};
-
-				for (const auto& pos : neighborsPos) {
-					if (m_chunks.find(pos) != m_chunks.end()) {
-						Chunk* neighborChunk = m_chunks[pos];
-						if (neighborChunk) {
-							m_chunksToGenerate.insert(neighborChunk);
-						}
-					}
-				}
+			if (m_chunks.find(chunkPos) == m_chunks.end() && m_chunksLoading.find(chunkPos) == m_chunksLoading.end()) {
+				missing.push_back(chunkPos);
 			}
 		}
 	}
+
+	// Nearest chunks are generated first
+	std::sort(missing.begin(), missing.end(), [playerChunkX, playerChunkZ](const glm::ivec3& a, const glm::ivec3& b) {
+		int da = (a.x - playerChunkX) * (a.x - playerChunkX) + (a.z - playerChunkZ) * (a.z - playerChunkZ);
+		int db = (b.x - playerChunkX) * (b.x - playerChunkX) + (b.z - playerChunkZ) * (b.z - playerChunkZ);
+		return da < db;
+	});
+
+	// Terrain is generated on the worker pool, the chunk joins the world once it is done
+	for (const glm::ivec3& chunkPos : missing) {
+		Chunk* chunk = new Chunk(chunkPos.x, chunkPos.y, chunkPos.z, this);
+		m_chunksLoading[chunkPos] = chunk;
+
+		meshThreadPool.enqueue([this, chunk]() {
+			if (!cancelGeneration) {
+				m_terrain.generate(chunk->getPositionGrid(), *chunk);
+			}
+			std::lock_guard<std::mutex> lock(generatedMutex);
+			generatedChunks.push_back(chunk);
+			});
+	}
+}
+
+void World::collectGeneratedChunks()
+{
+	std::vector<Chunk*> generated;
+	{
+		std::lock_guard<std::mutex> lock(generatedMutex);
+		generated.swap(generatedChunks);
+	}
+
+	for (Chunk* chunk : generated) {
+		glm::ivec3 chunkPos = chunk->getPositionGrid();
+		m_chunksLoading.erase(chunkPos);
+		m_chunks[chunkPos] = chunk;
+
+		// The chunk and each neighbor are meshed once all of their neighbors are generated,
+		// requestMesh skips the ones still missing some
+		requestMesh(chunk);
+		for (const glm::ivec3& offset : { glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1) }) {
+			auto neighbor = m_chunks.find(chunkPos + offset);
+			if (neighbor != m_chunks.end()) {
+				requestMesh(neighbor->second);
+			}
+		}
+	}
+}
+
+bool World::hasAllNeighbors(const glm::ivec3& chunkPos) const
+{
+	for (const glm::ivec3& offset : { glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1) }) {
+		if (m_chunks.find(chunkPos + offset) == m_chunks.end()) {
+			return false;
+		}
+	}
+	return true;
 }
 
 void World::unloadChunks(glm::vec3 playerPosition)
@@ -109,47 +169,92 @@ void World::unloadChunks(glm::vec3 playerPosition)
 
 void World::generateChunks()
 {
-	for (Chunk* chunk : m_chunksToGenerate) {
-		if (meshEnqueued.insert(chunk).second) {
-			meshThreadPool.enqueue([this, chunk]() {
-				chunk->generateMeshData();
-				{
-					std::lock_guard<std::mutex> lock(meshResultMutex);
-					meshResults.push(chunk);
-				}
-				});
+	for (auto it = m_chunksToGenerate.begin(); it != m_chunksToGenerate.end();) {
+		Chunk* chunk = *it;
+
+		// A chunk already being meshed works from an older snapshot, remesh it once that job is done
+		if (!meshEnqueued.insert(chunk).second) {
+			++it;
+			continue;
 		}
+		it = m_chunksToGenerate.erase(it);
+
+		// Copy the chunk and its border now, the job then never reads live chunk data
+		ChunkSnapshot::Neighbors neighbors = {};
+		for (int dx = -1; dx <= 1; ++dx) {
+			for (int dz = -1; dz <= 1; ++dz) {
+				auto neighbor = m_chunks.find(chunk->getPositionGrid() + glm::ivec3(dx, 0, dz));
+				neighbors[dx + 1][dz + 1] = neighbor != m_chunks.end() ? neighbor->second : nullptr;
+			}
+		}
+		auto snapshot = std::make_shared<ChunkSnapshot>();
+		snapshot->capture(*chunk, neighbors);
+		snapshot->binaryMesher = useBinaryMesher;
+		snapshot->sectionMask = chunk->takeDirtySections();
+
+		// Section remeshes come from block edits, run them ahead of chunk loading
+		bool urgent = snapshot->sectionMask != Chunk::ALL_SECTIONS;
+
+		meshThreadPool.enqueue([this, chunk, snapshot, urgent]() {
+			auto start = std::chrono::steady_clock::now();
+			MeshResult result{ chunk, meshDataPool.acquire(), meshDataPool.acquire() };
+			MeshScratch& scratch = *meshScratch[ThreadPool::workerIndex()];
+			chunk->generateMeshData(*snapshot, scratch, *result.opaque, *result.transparent);
+			result.connectivity = VisibilityGraph::computeConnectivity(*snapshot, scratch);
+			auto elapsed = std::chrono::steady_clock::now() - start;
+
+			// Throughput stats cover whole chunks only
+			if (!urgent) {
+				meshTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+				meshedChunks++;
+			}
+			{
+				std::lock_guard<std::mutex> lock(meshResultMutex);
+				meshResults.push(std::move(result));
+			}
+			}, urgent);
 	}
-	m_chunksToGenerate.clear();
 }
 
 void World::setupChunks()
 {
 	int processed = 0;
 	while (processed < NUM_CHUNK_PER_FRAME) {
-		Chunk* chunk = nullptr;
+		MeshResult result;
 		{   
 			// pop one result
 			std::lock_guard<std::mutex> lock(meshResultMutex);
 			if (meshResults.empty()) break;
-			chunk = meshResults.front();
+			result = std::move(meshResults.front());
 			meshResults.pop();
 		}
+		Chunk* chunk = result.chunk;
 		if (!chunk) continue;
 
-		chunk->getMesh()->setupMesh();
-		chunk->getTransparentMesh()->setupMesh();
-		chunk->swapMeshes(); 
+		// Section patches are small, only full uploads count against the per-frame budget
+		bool fullMesh = result.opaque->sectionMask == Chunk::ALL_SECTIONS;
+		chunk->uploadMesh(result.opaque, result.transparent, !gpuResidentMeshes);
+		chunk->setFaceConnectivity(result.connectivity);
 
-		m_chunksToRender.insert(chunk); // TODO: sort render list by distance and angle to player (closest and visible chunks first)
+		// The payloads now hold the buffers they replaced, recycle them for the next jobs
+		meshDataPool.release(std::move(result.opaque));
+		meshDataPool.release(std::move(result.transparent));
+
+		// New chunks join the back of the render queue, the next sort moves them into place
+		if (m_chunksToRender.insert(chunk).second) {
+			m_renderQueue.push_back({ chunk, 0.0f });
+		}
 
 		meshEnqueued.erase(chunk);
-		++processed;
+		if (fullMesh) {
+			++processed;
+		}
 	}
 }
 
 void World::removeChunks()
 {
+	bool removed = false;
 	for (auto const& coord : m_chunksToRemove)
 	{
 		auto it = m_chunks.find(coord);
@@ -158,35 +263,83 @@ void World::removeChunks()
 
 		Chunk* chunk = it->second;
 
+		// The mesh job still writes into the chunk, unloadChunks will ask again next frame
+		if (meshEnqueued.count(chunk)) {
+			continue;
+		}
+
 		m_chunksToGenerate.erase(chunk);
-		m_chunksToRender.erase(chunk);
+		removed |= m_chunksToRender.erase(chunk) > 0;
 
 		m_chunks.erase(it);
 
 		delete chunk;
 	}
 
+	if (removed) {
+		m_renderQueue.erase(std::remove_if(m_renderQueue.begin(), m_renderQueue.end(),
+			[this](const RenderQueueEntry& entry) { return !m_chunksToRender.count(entry.chunk); }), m_renderQueue.end());
+	}
+
 	m_chunksToRemove.clear();
 }
 
-void World::updateChunk(Chunk* chunk)
+void World::sortRenderQueue(const glm::vec3& eye)
 {
-	glm::vec3 chunkPos = chunk->getPositionGrid();
+	for (RenderQueueEntry& entry : m_renderQueue) {
+		glm::vec3 center = (entry.chunk->getBoundsMin() + entry.chunk->getBoundsMax()) * 0.5f;
+		glm::vec3 offset = center - eye;
+		entry.distance = glm::dot(offset, offset);
+	}
+
+	// Insertion sort: the previous order is nearly right, so this stays close to linear
+	for (size_t i = 1; i < m_renderQueue.size(); ++i) {
+		RenderQueueEntry entry = m_renderQueue[i];
+		size_t j = i;
+		while (j > 0 && m_renderQueue[j - 1].distance > entry.distance) {
+			m_renderQueue[j] = m_renderQueue[j - 1];
+			--j;
+		}
+		m_renderQueue[j] = entry;
+	}
+}
+
+void World::requestMesh(Chunk* chunk, uint8_t sectionMask)
+{
+	// Meshing reads the borders of the four neighbors: without all of them the mesh would keep open
+	// walls, so the chunk waits for collectGeneratedChunks to queue it when the last one arrives
+	if (!hasAllNeighbors(chunk->getPositionGrid())) {
+		return;
+	}
+	chunk->markDirty(sectionMask);
 	m_chunksToGenerate.insert(chunk);
+}
 
-	// Update neighboring chunks
-	std::vector<glm::ivec3> neighborsPos = {
-		glm::ivec3(chunkPos.x - 1, 0, chunkPos.z),
-		glm::ivec3(chunkPos.x + 1, 0, chunkPos.z),
-		glm::ivec3(chunkPos.x, 0, chunkPos.z - 1),
-		glm::ivec3(chunkPos.x, 0, chunkPos.z + 1)
-	};
-
-	for (const auto& pos : neighborsPos) {
-		if (m_chunks.find(pos) != m_chunks.end()) {
-			Chunk* neighborChunk = m_chunks[pos];
-			if (neighborChunk) {
-				m_chunksToGenerate.insert(neighborChunk);
+void World::updateBlock(Chunk* chunk, const glm::ivec3& localPos)
+{
+	// Faces and AO of the cells around the block change, which reaches the next section at a section border
+	int section = localPos.y / Chunk::SECTION_HEIGHT;
+	int sectionY = localPos.y % Chunk::SECTION_HEIGHT;
+	uint8_t sections = uint8_t(1 << section);
+	if (sectionY == 0 && section > 0) {
+		sections |= 1 << (section - 1);
+	}
+	if (sectionY == Chunk::SECTION_HEIGHT - 1 && section < Chunk::SECTION_COUNT - 1) {
+		sections |= 1 << (section + 1);
+	}
+	requestMesh(chunk, sections);
+
+	// Neighbors only see the block when it lies on their border, diagonal ones through AO
+	int borderX = localPos.x == 0 ? -1 : (localPos.x == Chunk::CHUNK_SIZE - 1 ? 1 : 0);
+	int borderZ = localPos.z == 0 ? -1 : (localPos.z == Chunk::CHUNK_SIZE - 1 ? 1 : 0);
+	glm::ivec3 chunkPos = chunk->getWorldPosition();
+
+	for (int dx : { 0, borderX }) {
+		for (int dz : { 0, borderZ }) {
+			if (dx == 0 && dz == 0) continue;
+			Chunk* neighbor = getChunk(chunkPos.x + dx * Chunk::CHUNK_SIZE, chunkPos.y, chunkPos.z + dz * Chunk::CHUNK_SIZE);
+			if (neighbor) {
+				requestMesh(neighbor, sections);
 			}
 		}
 	}
@@ -320,19 +473,53 @@ bool World::isSolidBlock(int x, int y, int z) const
 	if (chunk) {
 		glm::vec3 localPos = glm::vec3(x, y, z) - chunk->getWorldPosition();
 		glm::ivec3 localBlockPos = glm::floor(localPos);
-		return chunk->cubes[localBlockPos.x][localBlockPos.y][localBlockPos.z] != BlockType::None &&
-			chunk->cubes[localBlockPos.x][localBlockPos.y][localBlockPos.z] != BlockType::Water;
+		return chunk->isSolid(localBlockPos.x, localBlockPos.y, localBlockPos.z);
 	}
 	return false;
 }
 
 void World::setAmbientOcclusion()
 {
+	// Meshes always carry AO levels, the renderer picks the chunk program with or without it
 	useAmbientOcclusion = !useAmbientOcclusion;
+}
+
+void World::setBinaryMesher()
+{
+	useBinaryMesher = !useBinaryMesher;
+	meshedChunks = 0;
+	meshTimeNs = 0;
 	for (auto& chunkPair : m_chunks) {
 		Chunk* chunk = chunkPair.second;
 		if (chunk) {
-			m_chunksToGenerate.insert(chunk);
+			requestMesh(chunk);
 		}
 	}
 }
+
+void World::setGpuResidentMeshes()
+{
+	gpuResidentMeshes = !gpuResidentMeshes;
+	for (auto& chunkPair : m_chunks) {
+		Chunk* chunk = chunkPair.second;
+		if (chunk) {
+			requestMesh(chunk);
+		}
+	}
+}
+
+void World::getMeshMemoryUsage(size_t& cpuBytes, size_t& gpuBytes) const
+{
+	cpuBytes = 0;
+	gpuBytes = 0;
+	for (const Chunk* chunk : m_chunksToRender) {
+		cpuBytes += chunk->getMeshCpuMemoryUsage();
+		gpuBytes += chunk->getMeshGpuMemoryUsage();
+	}
+}
+
+float World::getMeshTimeMs() const
+{
+	uint64_t count = meshedChunks;
+	return count ? float(meshTimeNs) / count / 1.0e6f : 0.0f;
+}
@@ -0,0 +1,181 @@
+// Differential test and benchmark of the chunk meshers. Snapshots of generated terrain, some with
+// random block edits, are meshed by the per-cell mesher (Chunk::processDirection) and by
+// BinaryMesher::generate; the sorted quads of every section must match, the tool exits with an
+// error on the first snapshot that differs. Then prints chunks/s for each mesher.
+// AO levels are always baked into the vertices and compared with them, the AO toggle only
+// switches the chunk program (see Renderer::ChunkShaderFeature), so there is no AO-off mesh.
+// Usage: mesher_diff [chunks] [seed]
+#include "chunk.h"
+#include "chunk_snapshot.h"
+#include "mesh_scratch.h"
+#include "mesh_data.h"
+#include "terrain_generator.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+	const int EDITS_PER_CHUNK = 400;
+
+	using QuadKey = std::array<uint64_t, 4>;
+
+	// Quads of one section, each as its 4 packed corners, in a canonical order
+	std::vector<QuadKey> sortedQuads(const MeshData::Section& section)
+	{
+		std::vector<QuadKey> quads;
+		for (size_t v = 0; v + 3 < section.vertices.size(); v += 4) {
+			QuadKey quad;
+			for (int i = 0; i < 4; ++i) {
+				const ChunkVertex& vertex = section.vertices[v + i];
+				quad[i] = uint64_t(vertex.position) << 32 | vertex.texture;
+			}
+			quads.push_back(quad);
+		}
+		std::sort(quads.begin(), quads.end());
+		return quads;
+	}
+
+	// Prints the first difference, returns whether the payloads hold the same geometry
+	bool compare(const char* pass, const MeshData& perCell, const MeshData& binary)
+	{
+		for (int s = 0; s < ChunkMesh::SECTION_COUNT; ++s) {
+			const MeshData::Section& a = perCell.sections[s];
+			const MeshData::Section& b = binary.sections[s];
+			if (a.faceQuadCount != b.faceQuadCount || a.quadCount != b.quadCount) {
+				std::fprintf(stderr, "%s section %d: %u quads per-cell, %u binary\n", pass, s, a.quadCount, b.quadCount);
+				return false;
+			}
+			if (sortedQuads(a) != sortedQuads(b)) {
+				std::fprintf(stderr, "%s section %d: same counts, different quads\n", pass, s);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// A 3x3 patch of generated chunks around the grid position, the snapshot is taken of the center
+	struct Patch {
+		std::unique_ptr<Chunk> chunks[3][3];
+	};
+
+	void generatePatch(const TerrainGenerator& terrain, const glm::ivec3& center, Patch& patch)
+	{
+		for (int dx = -1; dx <= 1; ++dx) {
+			for (int dz = -1; dz <= 1; ++dz) {
+				glm::ivec3 position = center + glm::ivec3(dx, 0, dz);
+				patch.chunks[dx + 1][dz + 1] = std::make_unique<Chunk>(position.x, position.y, position.z);
+				terrain.generate(position, *patch.chunks[dx + 1][dz + 1]);
+			}
+		}
+	}
+
+	// Random blocks in the center chunk and along the borders of its neighbors, every type included
+	void editPatch(Patch& patch, std::mt19937& rng)
+	{
+		const int size = Chunk::CHUNK_SIZE;
+		std::uniform_int_distribution<int> type(0, int(BlockType::NUM) - 1);
+		std::uniform_int_distribution<int> coord(0, size - 1);
+		std::uniform_int_distribution<int> height(0, Chunk::CHUNK_HEIGHT - 1);
+		std::uniform_int_distribution<int> border(0, 1);
+
+		for (int i = 0; i < EDITS_PER_CHUNK; ++i) {
+			patch.chunks[1][1]->setBlockType(coord(rng), height(rng), coord(rng), BlockType(type(rng)));
+
+			// The neighbor cells the center snapshot reads
+			int side = int(rng() % 4);
+			int dx = side == 0 ? -1 : (side == 1 ? 1 : 0);
+			int dz = side == 2 ? -1 : (side == 3 ? 1 : 0);
+			int x = dx < 0 ? size - 1 - border(rng) : (dx > 0 ? border(rng) : coord(rng));
+			int z = dz < 0 ? size - 1 - border(rng) : (dz > 0 ? border(rng) : coord(rng));
+			patch.chunks[dx + 1][dz + 1]->setBlockType(x, height(rng), z, BlockType(type(rng)));
+		}
+	}
+
+	void capture(const Patch& patch, ChunkSnapshot& snapshot)
+	{
+		ChunkSnapshot::Neighbors neighbors = {};
+		for (int x = 0; x < 3; ++x) {
+			for (int z = 0; z < 3; ++z) {
+				neighbors[x][z] = patch.chunks[x][z].get();
+			}
+		}
+		snapshot.capture(*patch.chunks[1][1], neighbors);
+	}
+
+	void mesh(const Chunk& chunk, ChunkSnapshot& snapshot, bool binaryMesher, MeshScratch& scratch, MeshData& opaque, MeshData& transparent)
+	{
+		snapshot.binaryMesher = binaryMesher;
+		opaque.clear();
+		transparent.clear();
+		chunk.generateMeshData(snapshot, scratch, opaque, transparent);
+	}
+
+	double secondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int chunkCount = argc > 1 ? std::atoi(argv[1]) : 64;
+	unsigned seed = argc > 2 ? unsigned(std::atoi(argv[2])) : 1u;
+	if (chunkCount <= 0) {
+		std::fprintf(stderr, "Usage: %s [chunks] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	TerrainGenerator terrain;
+	auto scratch = std::make_unique<MeshScratch>();
+	MeshData perCellOpaque, perCellTransparent, binaryOpaque, binaryTransparent;
+
+	// Odd chunks get random edits, some snapshots only mesh a few sections as block edits do
+	std::vector<std::unique_ptr<Patch>> patches;
+	std::vector<std::unique_ptr<ChunkSnapshot>> snapshots;
+	size_t quads = 0;
+	for (int i = 0; i < chunkCount; ++i) {
+		glm::ivec3 center(int(rng() % 64) - 32, 0, int(rng() % 64) - 32);
+		auto patch = std::make_unique<Patch>();
+		generatePatch(terrain, center, *patch);
+		if (i % 2) {
+			editPatch(*patch, rng);
+		}
+
+		auto snapshot = std::make_unique<ChunkSnapshot>();
+		capture(*patch, *snapshot);
+		if (i % 4 == 3) {
+			snapshot->sectionMask = uint8_t(1 + rng() % Chunk::ALL_SECTIONS);
+		}
+
+		const Chunk& chunk = *patch->chunks[1][1];
+		mesh(chunk, *snapshot, false, *scratch, perCellOpaque, perCellTransparent);
+		mesh(chunk, *snapshot, true, *scratch, binaryOpaque, binaryTransparent);
+		if (!compare("opaque", perCellOpaque, binaryOpaque) || !compare("transparent", perCellTransparent, binaryTransparent)) {
+			std::fprintf(stderr, "Meshers differ on chunk %d at (%d, %d)%s\n", i, center.x, center.z, i % 2 ? " with edits" : "");
+			return 1;
+		}
+		quads += binaryOpaque.getQuadCount() + binaryTransparent.getQuadCount();
+
+		patches.push_back(std::move(patch));
+		snapshots.push_back(std::move(snapshot));
+	}
+	std::printf("%d chunks meshed identically, %zu quads\n", chunkCount, quads);
+
+	// Throughput over the same snapshots, whole chunks only
+	for (bool binaryMesher : { false, true }) {
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < snapshots.size(); ++i) {
+			snapshots[i]->sectionMask = Chunk::ALL_SECTIONS;
+			mesh(*patches[i]->chunks[1][1], *snapshots[i], binaryMesher, *scratch, binaryOpaque, binaryTransparent);
+		}
+		double seconds = secondsSince(start);
+		std::printf("%-9s %8.1f chunks/s  %.3f ms/chunk\n", binaryMesher ? "Binary" : "Per-cell", snapshots.size() / seconds, seconds * 1000.0 / snapshots.size());
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+// Microbenchmark of the terrain height noise: one fnlGetNoise2D call per column against
+// PerlinBatch over whole chunk grids, on every path the CPU supports. Also checks that each
+// path matches FastNoiseLite, exits with an error when one drifts.
+// Usage: noise_bench [chunks]
+#define FNL_IMPL
+#include <FastNoiseLite.h>
+#include "perlin_batch.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+	// Chunk::CHUNK_SIZE, and the terrain height noise settings (see TerrainGenerator)
+	const int GRID = 48;
+	const int SEED = 1337;
+	const float FREQUENCY = 0.015f;
+	const float TOLERANCE = 1e-6f;
+
+	// Chunk origins spiraling out from the world origin, negative coordinates included
+	int originOf(int chunk, int axis)
+	{
+		int side = 64;
+		int cx = chunk % side - side / 2;
+		int cz = chunk / side % side - side / 2;
+		return (axis == 0 ? cx : cz) * GRID;
+	}
+
+	double secondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int chunks = argc > 1 ? std::atoi(argv[1]) : 4096;
+	if (chunks <= 0) {
+		std::fprintf(stderr, "Usage: %s [chunks]\n", argv[0]);
+		return 1;
+	}
+	const double columns = double(chunks) * GRID * GRID;
+
+	fnl_state state = fnlCreateState();
+	state.seed = SEED;
+	state.noise_type = FNL_NOISE_PERLIN;
+	state.frequency = FREQUENCY;
+
+	std::vector<float> reference(size_t(chunks) * GRID * GRID);
+	auto start = std::chrono::steady_clock::now();
+	for (int c = 0; c < chunks; ++c) {
+		float* out = reference.data() + size_t(c) * GRID * GRID;
+		for (int z = 0; z < GRID; ++z) {
+			for (int x = 0; x < GRID; ++x) {
+				out[z * GRID + x] = fnlGetNoise2D(&state, originOf(c, 0) + x, originOf(c, 1) + z);
+			}
+		}
+	}
+	double fnlSeconds = secondsSince(start);
+	std::printf("%-14s %8.1f M columns/s\n", "FastNoiseLite", columns / fnlSeconds / 1e6);
+
+	PerlinBatch noise(SEED, FREQUENCY);
+	std::vector<float> batch(reference.size());
+	bool matches = true;
+
+	for (PerlinBatch::Path path : { PerlinBatch::Path::Scalar, PerlinBatch::Path::SSE41, PerlinBatch::Path::AVX2 }) {
+		const char* name = PerlinBatch::getPathName(path);
+		if (!PerlinBatch::isSupported(path)) {
+			std::printf("%-14s not supported\n", name);
+			continue;
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (int c = 0; c < chunks; ++c) {
+			noise.sampleGrid(originOf(c, 0), originOf(c, 1), GRID, GRID, batch.data() + size_t(c) * GRID * GRID, path);
+		}
+		double seconds = secondsSince(start);
+
+		float maxError = 0.0f;
+		for (size_t i = 0; i < batch.size(); ++i) {
+			maxError = std::max(maxError, std::fabs(batch[i] - reference[i]));
+		}
+		matches = matches && maxError <= TOLERANCE;
+
+		std::printf("%-14s %8.1f M columns/s  %5.2fx  max error %g\n", name, columns / seconds / 1e6, fnlSeconds / seconds, maxError);
+	}
+
+	std::printf("Best path: %s\n", PerlinBatch::getPathName(PerlinBatch::getBestPath()));
+	if (!matches) {
+		std::fprintf(stderr, "Batched noise differs from FastNoiseLite by more than %g\n", TOLERANCE);
+		return 1;
+	}
+	return 0;
+}
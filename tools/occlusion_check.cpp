@@ -0,0 +1,251 @@
+// Headless check of OcclusionCuller against ray cast ground truth. Random terrain-like scenes of
+// occluder tiles are culled from a random camera; every candidate box reported hidden is then
+// probed with rays from the eye to points of its surface, and one unobstructed ray is a failure.
+// The SSE2 and scalar rasterizers must also produce the same depth buffer.
+// A second pass checks results reused a frame late (see Renderer::startOcclusionCulling): boxes
+// hidden with padded inputs must stay hidden from an eye moved within the padding and turned a little.
+// Usage: occlusion_check [scenes] [seed]
+#include "occlusion_culler.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+	using Box = OcclusionCuller::Box;
+
+	const int TILES = 22;  // grid side, ring included
+	const float TILE_SIZE = 12.0f;
+	const int CANDIDATES = 300;
+	const int RAYS_PER_BOX = 600;
+
+	struct Scene {
+		glm::vec3 eye;
+		glm::vec3 forward;
+		glm::mat4 viewProjection;
+		std::vector<int> heights;
+		glm::vec3 origin;
+		std::vector<Box> occluders;
+		std::vector<Box> candidates;
+	};
+
+	struct Stats {
+		int inView = 0;
+		int culled = 0;
+		int falseHidden = 0;
+		int depthMismatches = 0;
+		int asyncMismatches = 0;
+	};
+
+	glm::mat4 makeViewProjection(const glm::vec3& eye, const glm::vec3& forward)
+	{
+		glm::mat4 projection = glm::perspective(1.2f, 2.0f, 0.1f, 800.0f);
+		return projection * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	glm::vec3 randomForward(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		return glm::vec3(unit(rng) * 2 - 1, -0.3f - unit(rng) * 0.4f, unit(rng) * 2 - 1);
+	}
+
+	// Rolling columns of terrain around the origin, and boxes scattered in and above it
+	Scene makeScene(std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		Scene scene;
+		float extent = TILES * TILE_SIZE;
+		scene.origin = glm::vec3(-extent / 2, 0.0f, -extent / 2);
+
+		float phaseX = unit(rng) * 6.3f, phaseZ = unit(rng) * 6.3f;
+		int maxHeight = 0;
+		for (int z = 0; z < TILES; ++z) {
+			for (int x = 0; x < TILES; ++x) {
+				float wave = std::sin(x * 0.5f + phaseX) + std::sin(z * 0.4f + phaseZ);
+				int height = std::max(1, int(16.0f + 6.0f * wave + unit(rng) * 6.0f));
+				maxHeight = std::max(maxHeight, height);
+				scene.heights.push_back(height);
+			}
+		}
+		OcclusionCuller::addColumnOccluders(scene.heights, TILES, TILES, scene.origin, TILE_SIZE, 0.0f, scene.occluders);
+		for (int i = 0; i < CANDIDATES; ++i) {
+			glm::vec3 min(unit(rng) * extent - extent / 2, unit(rng) * 30.0f, unit(rng) * extent - extent / 2);
+			scene.candidates.push_back({ min, min + glm::vec3(4 + unit(rng) * 8, 2 + unit(rng) * 6, 4 + unit(rng) * 8) });
+		}
+
+		scene.eye = glm::vec3(unit(rng) * 40 - 20, maxHeight + 2.0f + unit(rng) * 10.0f, unit(rng) * 40 - 20);
+		scene.forward = randomForward(rng);
+		scene.viewProjection = makeViewProjection(scene.eye, scene.forward);
+		return scene;
+	}
+
+	// Slab test of the segment from origin along dir (unit length) up to length
+	bool segmentHitsBox(const Box& box, const glm::vec3& origin, const glm::vec3& dir, float length)
+	{
+		float t0 = 0.0f, t1 = length;
+		for (int axis = 0; axis < 3; ++axis) {
+			float inv = 1.0f / dir[axis];
+			float a = (box.min[axis] - origin[axis]) * inv;
+			float b = (box.max[axis] - origin[axis]) * inv;
+			if (a > b) std::swap(a, b);
+			t0 = std::max(t0, a);
+			t1 = std::min(t1, b);
+			if (t0 > t1) return false;
+		}
+		return true;
+	}
+
+	// Whether a ray from the eye reaches a point of the box surface inside the view, inView tells
+	// if any sampled point was in the view at all
+	bool isBoxSeen(const Box& box, const glm::vec3& eye, const glm::mat4& viewProjection, const std::vector<Box>& occluders, std::mt19937& rng, bool& inView)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		inView = false;
+		for (int i = 0; i < RAYS_PER_BOX; ++i) {
+			glm::vec3 p = box.min + (box.max - box.min) * glm::vec3(unit(rng), unit(rng), unit(rng));
+			int axis = rng() % 3;
+			p[axis] = rng() % 2 ? box.max[axis] : box.min[axis];
+
+			glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+			if (clip.w <= 0.0f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w) {
+				continue;
+			}
+			inView = true;
+
+			glm::vec3 dir = p - eye;
+			float length = glm::length(dir);
+			dir /= length;
+			bool blocked = false;
+			for (const Box& occluder : occluders) {
+				if (segmentHitsBox(occluder, eye, dir, length - 1e-3f)) {
+					blocked = true;
+					break;
+				}
+			}
+			if (!blocked) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void rasterize(OcclusionCuller& culler, const Scene& scene, const std::vector<Box>& occluders)
+	{
+		culler.beginFrame(scene.viewProjection, scene.eye);
+		for (const Box& box : occluders) {
+			culler.rasterizeBox(box);
+		}
+	}
+
+	void checkScene(const Scene& scene, std::mt19937& rng, Stats& stats)
+	{
+		OcclusionCuller culler;
+#ifdef VOXL_OCCLUSION_SSE
+		culler.useSimd = false;
+		rasterize(culler, scene, scene.occluders);
+		std::vector<float> scalarDepth = culler.getDepthBuffer();
+		culler.useSimd = true;
+		rasterize(culler, scene, scene.occluders);
+		stats.depthMismatches += culler.getDepthBuffer() != scalarDepth;
+#else
+		rasterize(culler, scene, scene.occluders);
+#endif
+		culler.buildHiZ();
+
+		// The worker path must agree with the synchronous one
+		OcclusionCuller asyncCuller;
+		std::vector<Box> occluders = scene.occluders;
+		std::vector<Box> candidates = scene.candidates;
+		asyncCuller.cullAsync(scene.viewProjection, scene.eye, occluders, candidates);
+		const std::vector<uint8_t>& results = asyncCuller.waitResults();
+
+		for (size_t i = 0; i < scene.candidates.size(); ++i) {
+			bool visible = culler.isBoxVisible(scene.candidates[i]);
+			stats.asyncMismatches += visible != bool(results[i]);
+
+			bool inView;
+			bool seen = isBoxSeen(scene.candidates[i], scene.eye, scene.viewProjection, scene.occluders, rng, inView);
+			if (!inView) continue;
+			stats.inView++;
+			if (!visible) {
+				stats.culled++;
+				stats.falseHidden += seen;
+			}
+		}
+	}
+
+	// Cull with shrunk occluders and grown candidates, then look from an eye moved within the padding
+	void checkPaddedScene(const Scene& scene, std::mt19937& rng, Stats& stats)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		float padding = 0.5f + unit(rng) * 2.0f;
+		glm::vec3 pad(padding);
+
+		std::vector<Box> occluders;
+		OcclusionCuller::addColumnOccluders(scene.heights, TILES, TILES, scene.origin, TILE_SIZE, padding, occluders);
+
+		OcclusionCuller culler;
+		culler.partialBoxesVisible = true;
+		rasterize(culler, scene, occluders);
+		culler.buildHiZ();
+
+		glm::vec3 offset = glm::normalize(glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f)) * padding * unit(rng);
+		glm::vec3 eye = scene.eye + offset;
+		glm::vec3 turn(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f);
+		glm::mat4 viewProjection = makeViewProjection(eye, scene.forward + turn * 0.3f);
+
+		for (const Box& candidate : scene.candidates) {
+			bool visible = culler.isBoxVisible({ candidate.min - pad, candidate.max + pad });
+
+			bool inView;
+			bool seen = isBoxSeen(candidate, eye, viewProjection, scene.occluders, rng, inView);
+			if (!inView) continue;
+			stats.inView++;
+			if (!visible) {
+				stats.culled++;
+				stats.falseHidden += seen;
+			}
+		}
+	}
+
+	void report(const char* name, const Stats& stats)
+	{
+		std::printf("%-8s %6d boxes in view, %6d culled, %d hidden but visible, %d depth buffer mismatches, %d async mismatches\n",
+			name, stats.inView, stats.culled, stats.falseHidden, stats.depthMismatches, stats.asyncMismatches);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int scenes = argc > 1 ? std::atoi(argv[1]) : 40;
+	unsigned seed = argc > 2 ? unsigned(std::atoi(argv[2])) : 1u;
+	if (scenes <= 0) {
+		std::fprintf(stderr, "Usage: %s [scenes] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	Stats direct, padded;
+	for (int i = 0; i < scenes; ++i) {
+		Scene scene = makeScene(rng);
+		checkScene(scene, rng, direct);
+		checkPaddedScene(scene, rng, padded);
+	}
+	report("Direct", direct);
+	report("Padded", padded);
+
+	bool failed = direct.falseHidden || direct.depthMismatches || direct.asyncMismatches || padded.falseHidden;
+	if (direct.culled == 0) {
+		// A culler hiding nothing passes trivially, the scenes must exercise it
+		std::fprintf(stderr, "No box was culled, the scenes test nothing\n");
+		failed = true;
+	}
+	if (failed) {
+		std::fprintf(stderr, "Occlusion culling check failed\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,45 @@
+// Offline texture packer: slices an atlas image into texture array layers and precomputes the
+// mip chain, writing a pack the game maps and uploads without decoding (see TexturePack).
+// Usage: texture_packer <atlas.png> <output.vxtp> <cols> <rows>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#include "texture_pack.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+int main(int argc, char** argv)
+{
+	if (argc != 5) {
+		std::cerr << "Usage: " << argv[0] << " <atlas.png> <output.vxtp> <cols> <rows>" << std::endl;
+		return 1;
+	}
+	int cols = std::atoi(argv[3]);
+	int rows = std::atoi(argv[4]);
+
+	// Bottom row first, as the runtime loader has always uploaded the atlas
+	stbi_set_flip_vertically_on_load(true);
+	int width, height, channels;
+	unsigned char* atlas = stbi_load(argv[1], &width, &height, &channels, 4);
+	if (!atlas) {
+		std::cerr << "Failed to load atlas: " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> pack;
+	std::string error;
+	bool built = TexturePack::build(atlas, width, height, cols, rows, pack, error);
+	stbi_image_free(atlas);
+	if (!built) {
+		std::cerr << argv[1] << ": " << error << std::endl;
+		return 1;
+	}
+
+	std::ofstream out(argv[2], std::ios::binary | std::ios::trunc);
+	if (!out.write(reinterpret_cast<const char*>(pack.data()), pack.size())) {
+		std::cerr << "Failed to write " << argv[2] << std::endl;
+		return 1;
+	}
+	std::cout << "Packed " << cols * rows << " layers into " << argv[2] << " (" << pack.size() << " bytes)" << std::endl;
+	return 0;
+}